@@ -0,0 +1,1234 @@
+// Benchmark drivers for the dispatcher, built as their own program so the
+// allocation counter and the OSRM stand-in stay out of ers.exe:
+//   g++ -std=c++17 -O2 -o ers_bench.exe bench.cpp -I. -lcurl
+#define ERS_NO_MAIN
+#define ERS_COUNT_ALLOCATIONS
+#include "FINAL.CPP"
+
+// Canned OSRM /route response used by the local stand-in server
+const char* sampleOsrmRouteJson() {
+    return R"({"code":"Ok","routes":[{"geometry":"kzq~Dymf{M","legs":[{"steps":[)"
+           R"({"geometry":"kzq~Dymf{M??","maneuver":{"bearing_after":12,"bearing_before":0,"location":[77.2177,28.6304],"type":"depart","instruction":"Head north on Janpath"},"mode":"driving","driving_side":"left","name":"Janpath","intersections":[{"out":0,"entry":[true],"bearings":[12],"location":[77.2177,28.6304]}],"weight":95.2,"duration":95.2,"distance":812.4},)"
+           R"({"geometry":"gpr~Dmaf{M??","maneuver":{"bearing_after":98,"bearing_before":12,"location":[77.2190,28.6375],"modifier":"right","type":"turn","instruction":"Turn right onto Barakhamba Road"},"mode":"driving","driving_side":"left","name":"Barakhamba Road","intersections":[{"out":1,"in":2,"entry":[true,true,false],"bearings":[10,98,192],"location":[77.2190,28.6375]}],"weight":141.7,"duration":141.7,"distance":1320.9},)"
+           R"({"geometry":"}sr~Dwpf{M??","maneuver":{"bearing_after":180,"bearing_before":98,"location":[77.2312,28.6301],"modifier":"right","type":"turn","instruction":"Turn right onto Mathura Road"},"mode":"driving","driving_side":"left","name":"Mathura Road","intersections":[{"out":2,"in":3,"entry":[true,false,true,false],"bearings":[0,90,180,278],"location":[77.2312,28.6301]}],"weight":210.3,"duration":210.3,"distance":2410.6},)"
+           R"({"geometry":"_ir~Dcqf{M","maneuver":{"bearing_after":0,"bearing_before":180,"location":[77.2300,28.6080],"type":"arrive","instruction":"You have arrived at your destination"},"mode":"driving","driving_side":"left","name":"Mathura Road","intersections":[{"in":0,"entry":[true],"bearings":[0],"location":[77.2300,28.6080]}],"weight":0,"duration":0,"distance":0})"
+           R"(],"summary":"Janpath, Mathura Road","weight":447.2,"duration":447.2,"distance":4543.9}],"weight_name":"routability","weight":447.2,"duration":447.2,"distance":4543.9}],)"
+           R"("waypoints":[{"hint":"","distance":3.1,"name":"Janpath","location":[77.2177,28.6304]},{"hint":"","distance":4.2,"name":"Mathura Road","location":[77.2300,28.6080]}]})";
+}
+
+// Local stand-in for an OSRM server so routing can be benchmarked without the
+// public demo server. delayMs simulates the server's processing time. It
+// listens with FINAL.CPP's CPPHTTPLIB_LISTEN_BACKLOG, which keeps the batched
+// benches' bursts of curl connections from being refused.
+class LocalOsrmStandIn {
+private:
+    httplib::Server server;
+    thread listener;
+    int port;
+
+public:
+    explicit LocalOsrmStandIn(int delayMs = 0, size_t threads = 8) {
+        server.set_tcp_nodelay(true);
+        server.new_task_queue = [threads] { return new httplib::ThreadPool(threads); };
+        server.Get(R"(/route/v1/driving/.*)", [delayMs](const httplib::Request&, httplib::Response& res) {
+            if (delayMs > 0) this_thread::sleep_for(chrono::milliseconds(delayMs));
+            res.set_content(sampleOsrmRouteJson(), "application/json");
+        });
+        // Durations at a flat 10 m/s over straight-line distance
+        server.Get(R"(/table/v1/driving/([^?]*))", [delayMs](const httplib::Request& req, httplib::Response& res) {
+            if (delayMs > 0) this_thread::sleep_for(chrono::milliseconds(delayMs));
+            vector<pair<double, double>> points; // (lat, lon)
+            istringstream coordinates(req.matches[1].str());
+            string point;
+            while (getline(coordinates, point, ';')) {
+                double lon, lat;
+                if (sscanf(point.c_str(), "%lf,%lf", &lon, &lat) == 2) points.emplace_back(lat, lon);
+            }
+            auto indices = [&](const char* key) {
+                vector<size_t> selected;
+                istringstream list(req.get_param_value(key));
+                string index;
+                while (getline(list, index, ';')) {
+                    size_t i = strtoul(index.c_str(), nullptr, 10);
+                    if (i < points.size()) selected.push_back(i);
+                }
+                if (!req.has_param(key)) {
+                    for (size_t i = 0; i < points.size(); ++i) selected.push_back(i);
+                }
+                return selected;
+            };
+            nlohmann::json durations = nlohmann::json::array();
+            for (size_t from : indices("sources")) {
+                nlohmann::json row = nlohmann::json::array();
+                for (size_t to : indices("destinations")) {
+                    row.push_back(haversineDistance(points[from].first, points[from].second,
+                                                    points[to].first, points[to].second) * 100.0);
+                }
+                durations.push_back(row);
+            }
+            res.set_content(nlohmann::json{{"code", "Ok"}, {"durations", durations}}.dump(), "application/json");
+        });
+        port = server.bind_to_any_port("127.0.0.1");
+        listener = thread([this] { server.listen_after_bind(); });
+        server.wait_until_ready();
+    }
+
+    ~LocalOsrmStandIn() {
+        server.stop();
+        listener.join();
+    }
+
+    string url() const { return "http://127.0.0.1:" + to_string(port); }
+};
+
+// Compare the old connection-per-request pattern with the pooled client
+void benchRouting(int requests) {
+    LocalOsrmStandIn standIn;
+    OsrmClient client(standIn.url());
+    string url = client.routeUrl(28.6304, 77.2177, 28.6080, 77.2300);
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < requests; ++i) {
+        string response;
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        CURL* curl = curl_easy_init();
+        ResponseReceiver<string> receiver{curl, &response};
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback<string>);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &receiver);
+        curl_easy_perform(curl);
+        curl_easy_cleanup(curl);
+        curl_global_cleanup();
+    }
+    double freshSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    client.get(url); // warm the pooled connection
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < requests; ++i) client.get(url);
+    double pooledSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Routing benchmark against " << standIn.url() << " (" << requests << " requests)" << endl;
+    cout << "  new connection per request: " << freshSeconds * 1e6 / requests << " us/request" << endl;
+    cout << "  pooled keep-alive client:   " << pooledSeconds * 1e6 / requests << " us/request" << endl;
+}
+
+// Full DOM parse of an OSRM response vs the streaming step extractor
+void benchRouteParsing(int iterations) {
+    const string routeJson = sampleOsrmRouteJson();
+    size_t checksum = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        auto document = nlohmann::json::parse(routeJson);
+        checksum += document["routes"][0]["legs"][0]["steps"].size();
+    }
+    double domSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        Route route;
+        OsrmStepExtractor extractor(route);
+        ArenaJson::sax_parse(routeJson.begin(), routeJson.end(), &extractor);
+        checksum += route.steps.size();
+    }
+    double saxSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Fed one TCP segment at a time, as it would come off the connection
+    const size_t chunk = 1448;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        Route route;
+        OsrmRouteStream stream(route);
+        for (size_t at = 0; at < routeJson.size(); at += chunk) {
+            stream.append(routeJson.data() + at, min(chunk, routeJson.size() - at));
+        }
+        stream.finish();
+        checksum += route.steps.size();
+    }
+    double pushSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Route parsing benchmark (" << iterations << " responses, " << routeJson.size() << " bytes each)" << endl;
+    cout << "  json::parse DOM:      " << domSeconds * 1e6 / iterations << " us/route" << endl;
+    cout << "  SAX step extractor:   " << saxSeconds * 1e6 / iterations << " us/route" << endl;
+    cout << "  push parser, chunked: " << pushSeconds * 1e6 / iterations << " us/route" << endl;
+    if (checksum == 0) cout << "  (no steps parsed)" << endl;
+}
+
+// Writing dispatch reports the old way, row by row through an ostream with
+// endl, vs rendering each into a reused buffer and writing it once. Both go
+// to the null device, so only formatting and write() calls are measured.
+void benchReportRendering(int reports) {
+    Route route = parseOsrmRoute(sampleOsrmRouteJson());
+    pmr::vector<double> trafficFactors(route.steps.size(), 1.1);
+    GraphNode unit("Fire1", 28.6, 77.2, FIRE_BRIGADE);
+    EmergencyIncident incident("Connaught Place", FIRE, 28.63, 77.21);
+#ifdef _WIN32
+    const char* nullDevice = "NUL";
+#else
+    const char* nullDevice = "/dev/null";
+#endif
+
+    ofstream lines(nullDevice);
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < reports; ++r) {
+        lines << "Dispatching resource " << unit.id << " to incident at " << incident.place << endl;
+        lines << "+--------+-----------------------------------------+---------------------+--------------+-------------------+" << endl;
+        for (size_t i = 0; i < route.steps.size(); ++i) {
+            const RouteStep& step = route.steps[i];
+            lines << "| " << setw(6) << i + 1 << " | " << setw(39) << string_view(step.instruction).substr(0, 39)
+                  << " | " << setw(19) << fixed << setprecision(1) << step.distance
+                  << " | " << setw(12) << step.duration
+                  << " | " << setw(17) << setprecision(2) << trafficFactors[i] << " |" << endl;
+        }
+        lines << "+--------+-----------------------------------------+---------------------+--------------+-------------------+" << endl;
+    }
+    double streamSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Report rendering (" << reports << " dispatch reports, " << route.steps.size() << " steps each)" << endl;
+    cout << "  ostream, endl per line:  " << fixed << setprecision(2) << streamSeconds * 1e6 / reports
+         << " us/report, " << route.steps.size() + 3 << " writes" << endl;
+
+    static const char* const names[] = {"table", "compact", "json"};
+#ifdef _WIN32
+    int fd = _open(nullDevice, _O_WRONLY);
+#else
+    int fd = open(nullDevice, O_WRONLY);
+#endif
+    string text;
+    for (ReportFormat format : {REPORT_TABLE, REPORT_COMPACT, REPORT_JSON}) {
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < reports; ++r) {
+            text.clear();
+            renderDispatch(text, format, incident, &unit, &route, trafficFactors.data());
+            writeReport(text, fd);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "  buffered, " << left << setw(14) << string(names[format]) + ":" << right
+             << seconds * 1e6 / reports << " us/report, 1 write, " << text.size() << " bytes" << endl;
+    }
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+// Random fleet spread over Delhi for benchmarks
+vector<GraphNode> syntheticFleet(size_t units, unsigned seed = 42) {
+    srand(seed);
+    auto uniform = [](double lo, double hi) { return lo + (hi - lo) * rand() / RAND_MAX; };
+    vector<GraphNode> fleet;
+    fleet.reserve(units);
+    for (size_t i = 0; i < units; ++i) {
+        fleet.emplace_back("Unit_" + to_string(i), uniform(28.40, 28.88), uniform(76.84, 77.35),
+                           static_cast<ResourceType>(i % 3));
+    }
+    return fleet;
+}
+
+// Random incidents over the same area as syntheticFleet
+vector<EmergencyIncident> syntheticIncidents(size_t count, unsigned seed = 7) {
+    srand(seed);
+    auto uniform = [](double lo, double hi) { return lo + (hi - lo) * rand() / RAND_MAX; };
+    vector<EmergencyIncident> incidents;
+    incidents.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        incidents.emplace_back("Incident_" + to_string(i), static_cast<EmergencySeverity>(1 + i % 4),
+                               uniform(28.40, 28.88), uniform(76.84, 77.35));
+    }
+    return incidents;
+}
+
+// Discards everything written to cout while in scope
+struct CoutSilencer {
+    ios state{nullptr};
+    streambuf* saved;
+
+    CoutSilencer() {
+        state.copyfmt(cout);
+        saved = cout.rdbuf(nullptr);
+    }
+
+    ~CoutSilencer() {
+        cout.rdbuf(saved);
+        cout.clear();
+        cout.copyfmt(state);
+    }
+};
+
+// Serial vs batched dispatch of a burst against a stand-in with fixed latency
+void benchBatchedDispatch(size_t incidents) {
+    const int roundTripMs = 50;
+    LocalOsrmStandIn standIn(roundTripMs, incidents);
+    OsrmClient client(standIn.url());
+    client.setMaxConnectionsPerHost(static_cast<long>(incidents));
+
+    double seconds[2];
+    for (int batched = 0; batched < 2; ++batched) {
+        EmergencyResponseSystem system(syntheticFleet(incidents * 3));
+        system.setRoutingClient(client);
+        system.setRouteCache(nullptr);
+        for (const auto& incident : syntheticIncidents(incidents)) system.addIncident(incident);
+
+        CoutSilencer silence;
+        auto start = chrono::steady_clock::now();
+        if (batched) {
+            system.dispatchResourcesBatched();
+        } else {
+            system.dispatchResources();
+        }
+        seconds[batched] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    cout << "Dispatch of " << incidents << " incidents, " << roundTripMs << " ms per route" << endl;
+    cout << "  serial:  " << seconds[0] * 1000 << " ms" << endl;
+    cout << "  batched: " << seconds[1] * 1000 << " ms" << endl;
+}
+
+// Claim/release throughput under contention: lock-free CAS claims versus
+// the same operations behind one global mutex
+void benchClaimContention(size_t units) {
+    const int opsPerThread = 20000;
+    vector<EmergencyIncident> spots = syntheticIncidents(256);
+
+    cout << "Claim/release contention, " << units << " units, " << opsPerThread << " ops per thread" << endl;
+    for (unsigned threads : {1u, 2u, 4u, 8u, 16u}) {
+        double rates[2];
+        for (int locked = 0; locked < 2; ++locked) {
+            EmergencyResponseSystem system(syntheticFleet(units));
+            mutex globalLock;
+            atomic<size_t> failures{0};
+
+            auto work = [&](unsigned seed) {
+                for (int i = 0; i < opsPerThread; ++i) {
+                    const EmergencyIncident& spot = spots[(seed * 7919 + i) % spots.size()];
+                    unique_lock<mutex> guard(globalLock, defer_lock);
+                    if (locked) guard.lock();
+                    uint32_t token;
+                    GraphNode* unit = system.claimResource(spot, &token);
+                    if (!unit || !system.releaseResource(*unit, token)) failures++;
+                }
+            };
+
+            auto start = chrono::steady_clock::now();
+            vector<thread> pool;
+            for (unsigned t = 0; t < threads; ++t) pool.emplace_back(work, t);
+            for (auto& worker : pool) worker.join();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            rates[locked] = threads * opsPerThread / seconds;
+            if (failures) cout << "  " << failures << " claims failed" << endl;
+        }
+        cout << "  " << setw(2) << threads << " threads: lock-free " << setw(10) << fixed << setprecision(0)
+             << rates[0] << " ops/s, global mutex " << setw(10) << rates[1] << " ops/s" << endl;
+    }
+}
+
+// Scalar haversineDistance versus the batch kernel on cached trig, plus the
+// worst disagreement between them over points spread across the globe
+void benchBatchHaversine(size_t units) {
+    srand(11);
+    auto uniform = [](double lo, double hi) { return lo + (hi - lo) * rand() / RAND_MAX; };
+    vector<double> lat(units), lon(units), latRad(units), lonRad(units), cosLat(units);
+    for (size_t i = 0; i < units; ++i) {
+        lat[i] = uniform(-85, 85);
+        lon[i] = uniform(-180, 180);
+        DistanceQuery trig(lat[i], lon[i]);
+        latRad[i] = trig.latRad;
+        lonRad[i] = trig.lonRad;
+        cosLat[i] = trig.cosLat;
+    }
+    const int queries = 200;
+    vector<double> scalar(units), batch(units);
+    double scalarSeconds = 0, batchSeconds = 0, maxError = 0;
+
+    for (int q = 0; q < queries; ++q) {
+        double qLat = uniform(-85, 85), qLon = uniform(-180, 180);
+
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < units; ++i) scalar[i] = haversineDistance(qLat, qLon, lat[i], lon[i]);
+        scalarSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        batchHaversineKm(DistanceQuery(qLat, qLon), latRad.data(), lonRad.data(), cosLat.data(), units, batch.data());
+        batchSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        for (size_t i = 0; i < units; ++i) {
+            if (scalar[i] < 19000) maxError = max(maxError, fabs(scalar[i] - batch[i]));
+        }
+    }
+
+    double pairs = static_cast<double>(units) * queries;
+    cout << "Haversine microbenchmark, " << units << " units x " << queries << " queries" << endl;
+    cout << "  scalar haversineDistance: " << scalarSeconds * 1e9 / pairs << " ns/distance" << endl;
+    cout << "  batchHaversineKm:         " << batchSeconds * 1e9 / pairs << " ns/distance" << endl;
+    cout << "  max |error| below 19000 km: " << maxError * 1e6 << " mm" << endl;
+}
+
+// Nearest-available-unit lookups: flat AoS haversine scan of the whole fleet
+// (the original findBestResource) versus the grid index over the SoA store
+void benchNearestUnit(size_t units) {
+    vector<GraphNode> fleet = syntheticFleet(units);
+    ResourceSpatialIndex index;
+    index.build(fleet);
+    vector<EmergencyIncident> queries = syntheticIncidents(2000);
+    ResourceType types[] = {FIRE_BRIGADE, AMBULANCE, POLICE_VAN, POLICE_VAN};
+
+    vector<long> expected;
+    expected.reserve(queries.size());
+    auto start = chrono::steady_clock::now();
+    for (const auto& query : queries) {
+        ResourceType type = types[query.severity - 1];
+        long best = -1;
+        double minDistance = numeric_limits<double>::max();
+        for (size_t i = 0; i < fleet.size(); ++i) {
+            if (fleet[i].type != type || !fleet[i].isAvailable()) continue;
+            double distance = haversineDistance(query.latitude, query.longitude, fleet[i].latitude, fleet[i].longitude);
+            if (distance < minDistance) {
+                minDistance = distance;
+                best = static_cast<long>(i);
+            }
+        }
+        expected.push_back(best);
+    }
+    double linearSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t mismatches = 0;
+    start = chrono::steady_clock::now();
+    for (size_t q = 0; q < queries.size(); ++q) {
+        const EmergencyIncident& query = queries[q];
+        long best = index.nearestAvailable(fleet, types[query.severity - 1], query.latitude, query.longitude);
+        if (best != expected[q]) mismatches++;
+    }
+    double indexedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Nearest-unit lookup, " << units << " units, " << queries.size() << " queries" << endl;
+    cout << "  linear scan:    " << linearSeconds * 1e6 / queries.size() << " us/query" << endl;
+    cout << "  grid + SoA:     " << indexedSeconds * 1e6 / queries.size() << " us/query" << endl;
+    if (mismatches) cout << "  WARNING: " << mismatches << " lookups disagree with the linear scan" << endl;
+}
+
+// Fleet spread over northern India, wide enough that each unit has tens of
+// station links rather than the thousands a city-sized fleet would have
+vector<GraphNode> regionalFleet(size_t units, unsigned seed = 11) {
+    srand(seed);
+    auto uniform = [](double lo, double hi) { return lo + (hi - lo) * rand() / RAND_MAX; };
+    vector<GraphNode> fleet;
+    fleet.reserve(units);
+    for (size_t i = 0; i < units; ++i) {
+        fleet.emplace_back("Unit_" + to_string(i), uniform(20.0, 30.0), uniform(68.0, 88.0),
+                           static_cast<ResourceType>(i % 3));
+    }
+    return fleet;
+}
+
+// Station graph layouts on a regionalFleet: the former string-keyed adjacency
+// lists (every link holding a copy of its neighbour's ID) vs the CSR graph.
+// Compares memory, layout build time, a full neighbour scan (by ID for the
+// lists, by unit index for the CSR graph) and 2-hop neighbourhoods.
+void benchStationGraph(size_t units) {
+    vector<GraphNode> fleet = regionalFleet(units);
+
+    auto start = chrono::steady_clock::now();
+    EmergencyResponseSystem system(fleet);
+    double systemSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const StationGraph& graph = system.stations();
+
+    vector<StationGraph::Link> links;
+    links.reserve(graph.linkCount() / 2);
+    for (uint32_t i = 0; i < graph.stationCount(); ++i) {
+        for (size_t l = graph.firstLink(i); l < graph.endLink(i); ++l) {
+            if (graph.target(l) > i) links.push_back({i, graph.target(l), graph.weight(l)});
+        }
+    }
+
+    // Old layout, filled the way buildGraphConnections used to
+    start = chrono::steady_clock::now();
+    unordered_map<string, vector<pair<string, double>>> adjacency;
+    for (const auto& link : links) {
+        adjacency[fleet[link.from].id].push_back({fleet[link.to].id, link.distance});
+        adjacency[fleet[link.to].id].push_back({fleet[link.from].id, link.distance});
+    }
+    double listBuildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    size_t listBytes = adjacency.bucket_count() * sizeof(void*);
+    for (const auto& entry : adjacency) {
+        listBytes += sizeof(entry) + 2 * sizeof(void*); // node: value, next pointer, cached hash
+        if (entry.first.capacity() > 15) listBytes += entry.first.capacity() + 1;
+        listBytes += entry.second.capacity() * sizeof(entry.second[0]);
+        for (const auto& neighbour : entry.second) {
+            if (neighbour.first.capacity() > 15) listBytes += neighbour.first.capacity() + 1;
+        }
+    }
+
+    StationGraph rebuilt;
+    start = chrono::steady_clock::now();
+    rebuilt.build(fleet.size(), links);
+    double csrBuildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Full scan: total link length around every station
+    double listSum = 0.0, csrSum = 0.0;
+    start = chrono::steady_clock::now();
+    for (const auto& node : fleet) {
+        auto it = adjacency.find(node.id);
+        if (it == adjacency.end()) continue;
+        for (const auto& neighbour : it->second) listSum += neighbour.second;
+    }
+    double listScanSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    for (uint32_t station = 0; station < graph.stationCount(); ++station) {
+        for (size_t l = graph.firstLink(station); l < graph.endLink(station); ++l) csrSum += graph.weight(l);
+    }
+    double csrScanSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Stations within two links of a source, as a mutual-aid search would walk them
+    const size_t sources = min<size_t>(1000, units);
+    size_t listReached = 0, csrReached = 0;
+    start = chrono::steady_clock::now();
+    for (size_t s = 0; s < sources; ++s) {
+        const string& source = fleet[s * units / sources].id;
+        unordered_set<string> seen{source};
+        auto it = adjacency.find(source);
+        if (it == adjacency.end()) continue;
+        for (const auto& first : it->second) {
+            seen.insert(first.first);
+            auto next = adjacency.find(first.first);
+            for (const auto& second : next->second) seen.insert(second.first);
+        }
+        listReached += seen.size();
+    }
+    double listHopSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    vector<uint32_t> seenIn(graph.stationCount(), 0);
+    start = chrono::steady_clock::now();
+    for (size_t s = 0; s < sources; ++s) {
+        uint32_t source = static_cast<uint32_t>(s * units / sources);
+        uint32_t stamp = static_cast<uint32_t>(s + 1);
+        size_t reached = 1;
+        seenIn[source] = stamp;
+        for (size_t l = graph.firstLink(source); l < graph.endLink(source); ++l) {
+            uint32_t first = graph.target(l);
+            if (seenIn[first] != stamp) { seenIn[first] = stamp; ++reached; }
+            for (size_t m = graph.firstLink(first); m < graph.endLink(first); ++m) {
+                uint32_t second = graph.target(m);
+                if (seenIn[second] != stamp) { seenIn[second] = stamp; ++reached; }
+            }
+        }
+        csrReached += reached;
+    }
+    double csrHopSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    const double MB = 1024.0 * 1024.0;
+    cout << "Station graph, " << units << " units, " << graph.linkCount() << " directed links ("
+         << fixed << setprecision(1) << static_cast<double>(graph.linkCount()) / max<size_t>(units, 1)
+         << " per station), system built in " << systemSeconds * 1e3 << " ms" << endl;
+    cout << "  string-keyed lists: " << setw(7) << listBytes / MB << " MB, layout " << setw(7)
+         << listBuildSeconds * 1e3 << " ms, full scan " << setw(6) << listScanSeconds * 1e3 << " ms, 2-hop "
+         << setw(7) << listHopSeconds * 1e6 / sources << " us/source" << endl;
+    cout << "  CSR:                " << setw(7) << graph.linkBytes() / MB << " MB, layout " << setw(7)
+         << csrBuildSeconds * 1e3 << " ms, full scan " << setw(6) << csrScanSeconds * 1e3 << " ms, 2-hop "
+         << setw(7) << csrHopSeconds * 1e6 / sources << " us/source" << endl;
+    cout << "  memory " << listBytes / double(graph.linkBytes())
+         << "x smaller, scan " << listScanSeconds / csrScanSeconds << "x, 2-hop " << listHopSeconds / csrHopSeconds
+         << "x faster" << endl;
+    if (fabs(listSum - csrSum) > 1e-3 * max(1.0, listSum) || listReached != csrReached) {
+        cout << "  WARNING: layouts disagree (" << listSum << " vs " << csrSum << " km, "
+             << listReached << " vs " << csrReached << " reached)" << endl;
+    }
+}
+
+// Claims during a regional surge on a regionalFleet. Most units in a one-degree
+// square are taken first; each further incident in the square then claims and
+// releases a unit, once through the nearest-free-unit grid search and once
+// through the mutual-aid search bounded at radiusKm. Reports time per claim,
+// how many incidents were answered and how far away the units were.
+void benchMutualAid(size_t units, double radiusKm) {
+    vector<GraphNode> fleet = regionalFleet(units);
+    EmergencyResponseSystem system(fleet);
+
+    auto surge = [](size_t count, unsigned seed) {
+        srand(seed);
+        auto uniform = [](double lo, double hi) { return lo + (hi - lo) * rand() / RAND_MAX; };
+        vector<EmergencyIncident> incidents;
+        incidents.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            incidents.emplace_back("Surge_" + to_string(i), static_cast<EmergencySeverity>(1 + i % 3),
+                                   uniform(24.5, 25.5), uniform(77.5, 78.5));
+        }
+        return incidents;
+    };
+
+    // About 80% of the units inside the square (units / 200 per square degree)
+    size_t busy = 0;
+    for (const auto& incident : surge(units * 4 / 1000, 3)) busy += system.claimResource(incident) != nullptr;
+
+    vector<EmergencyIncident> queries = surge(2000, 5);
+    auto run = [&](double& seconds, double& meanKm) {
+        size_t answered = 0;
+        double totalKm = 0.0;
+        auto start = chrono::steady_clock::now();
+        for (const auto& incident : queries) {
+            uint32_t token;
+            GraphNode* unit = system.claimResource(incident, &token);
+            if (!unit) continue;
+            answered++;
+            totalKm += haversineDistance(incident.latitude, incident.longitude, unit->latitude, unit->longitude);
+            system.releaseResource(*unit, token);
+        }
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        meanKm = answered ? totalKm / answered : 0.0;
+        return answered;
+    };
+
+    double gridSeconds, gridKm, aidSeconds, aidKm;
+    size_t gridAnswered = run(gridSeconds, gridKm);
+    system.setMutualAidRadius(radiusKm);
+    size_t aidAnswered = run(aidSeconds, aidKm);
+
+    cout << "Mutual aid, " << units << " units (" << system.stations().linkCount() << " directed links), "
+         << busy << " taken by the surge, " << queries.size() << " incidents" << endl;
+    cout << fixed << setprecision(2);
+    cout << "  nearest free unit:      " << setw(7) << gridSeconds * 1e6 / queries.size() << " us/claim, "
+         << gridAnswered << " answered, mean " << gridKm << " km" << endl;
+    cout << "  mutual aid (" << setprecision(0) << radiusKm << " km): " << setprecision(2) << setw(7)
+         << aidSeconds * 1e6 / queries.size() << " us/claim, " << aidAnswered << " answered, mean "
+         << aidKm << " km" << endl;
+}
+
+// Wall time of a synthetic burst as the dispatcher worker pool grows
+void benchDispatchWorkers(size_t incidents) {
+    const int roundTripMs = 20;
+    LocalOsrmStandIn standIn(roundTripMs, 64);
+    OsrmClient client(standIn.url());
+
+    cout << "Dispatch of " << incidents << " incidents, " << roundTripMs << " ms per route" << endl;
+    for (unsigned workers : {1u, 2u, 4u, 8u, 16u, 32u}) {
+        EmergencyResponseSystem system(syntheticFleet(incidents * 3));
+        system.setRoutingClient(client);
+        system.setRouteCache(nullptr);
+        for (const auto& incident : syntheticIncidents(incidents)) system.addIncident(incident);
+
+        double seconds;
+        {
+            CoutSilencer silence;
+            auto start = chrono::steady_clock::now();
+            system.dispatchResourcesConcurrently(workers);
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        cout << "  " << setw(2) << workers << " workers: " << setw(8) << fixed << setprecision(1)
+             << seconds * 1000 << " ms, " << setw(8) << incidents / seconds << " incidents/s" << endl;
+    }
+}
+
+// HTTP ingestion: 8 keep-alive clients post the burst to an IncidentServer,
+// first one incident per request and then as NDJSON batches of 100. Reports
+// how fast incidents are accepted and how long until the engine has
+// dispatched them all, routing against an instant stand-in OSRM.
+void benchIncidentIngest(size_t incidents) {
+    LocalOsrmStandIn standIn(0, 16);
+    OsrmClient client(standIn.url());
+    EmergencyResponseSystem system(syntheticFleet(3000));
+    system.setRoutingClient(client);
+    IncidentServer server(system, 8, 32);
+    int port = server.start("127.0.0.1", 0);
+    if (port < 0) return;
+
+    vector<string> lines;
+    lines.reserve(incidents);
+    for (const auto& incident : syntheticIncidents(incidents)) {
+        lines.push_back(nlohmann::json{{"place", string(incident.place.str())}, {"severity", incident.severity},
+                                       {"lat", incident.latitude}, {"lon", incident.longitude}}.dump() + "\n");
+    }
+
+    const size_t clients = 8;
+    cout << "Incident ingestion over HTTP, " << incidents << " incidents, " << clients << " keep-alive clients" << endl;
+    for (size_t batch : {size_t(1), size_t(100)}) {
+        atomic<size_t> failures{0};
+        auto start = chrono::steady_clock::now();
+        vector<thread> senders;
+        for (size_t c = 0; c < clients; ++c) {
+            senders.emplace_back([&, c] {
+                httplib::Client http("127.0.0.1", port);
+                http.set_keep_alive(true);
+                http.set_tcp_nodelay(true); // headers and body go out as separate writes
+                for (size_t i = c * batch; i < lines.size(); i += clients * batch) {
+                    string body;
+                    for (size_t j = i; j < min(i + batch, lines.size()); ++j) body += lines[j];
+                    auto res = http.Post("/incidents", body, batch == 1 ? "application/json" : "application/x-ndjson");
+                    if (!res || res->status != 202) failures++;
+                }
+            });
+        }
+        for (auto& sender : senders) sender.join();
+        double acceptSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        server.waitIdle();
+        double dispatchSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "  " << setw(3) << batch << " per request: " << setw(9) << fixed << setprecision(0)
+             << incidents / acceptSeconds << " incidents/s accepted, all dispatched after " << setprecision(1)
+             << dispatchSeconds * 1000 << " ms" << endl;
+        if (failures) cout << "  WARNING: " << failures << " requests failed" << endl;
+    }
+
+    // The result of one more incident, fetched once it has been dispatched
+    httplib::Client http("127.0.0.1", port);
+    auto posted = http.Post("/incidents", lines[0], "application/json");
+    if (!posted || posted->status != 202) {
+        cout << "  WARNING: could not post an incident" << endl;
+        return;
+    }
+    server.waitIdle();
+    auto ids = nlohmann::json::parse(posted->body, nullptr, false);
+    if (ids.is_discarded() || !ids.contains("ids") || ids["ids"].empty()) {
+        cout << "  WARNING: unexpected reply " << posted->body;
+        return;
+    }
+    auto result = http.Get("/incidents/" + to_string(ids["ids"][0].get<uint64_t>()));
+    cout << "  GET /incidents/<id>: " << (result ? result->status : 0) << " " << (result ? result->body : string("\n"));
+}
+
+// Replaying recorded incidents into the queue from CSV and NDJSON text held
+// in memory, fed to IncidentReader in 1 MiB reads. The baselines read the
+// same rows the way the prompt did (iostreams into floats) and with one
+// nlohmann parse per NDJSON row. Also reports how far float coordinates are
+// from the recorded ones.
+void benchIncidentReplay(size_t rows) {
+    vector<EmergencyIncident> source = syntheticIncidents(rows);
+    string csv = "place,severity,lat,lon\n", ndjson;
+    csv.reserve(rows * 40);
+    ndjson.reserve(rows * 70);
+    for (size_t i = 0; i < rows; ++i) {
+        const EmergencyIncident& incident = source[i];
+        string place = "Sector " + to_string(i % 1000); // places recur, as in real call logs
+        appendFormat(csv, "%s,%d,%.6f,%.6f\n", place.c_str(), incident.severity, incident.latitude, incident.longitude);
+        appendFormat(ndjson, "{\"place\":\"%s\",\"severity\":%d,\"lat\":%.6f,\"lon\":%.6f}\n",
+                     place.c_str(), incident.severity, incident.latitude, incident.longitude);
+    }
+
+    auto replay = [](const string& text, size_t& queued) {
+        EmergencyResponseSystem system;
+        auto start = chrono::steady_clock::now();
+        IncidentReader reader("bench", [&system](const vector<EmergencyIncident>& batch) { system.addIncidents(batch); });
+        for (size_t at = 0; at < text.size(); at += 1 << 20) {
+            reader.append(text.data() + at, min<size_t>(1 << 20, text.size() - at));
+        }
+        reader.finish();
+        queued = reader.rowCount();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+
+    // As the prompt read them: a line at a time, coordinates into floats
+    size_t streamRows = 0;
+    auto start = chrono::steady_clock::now();
+    {
+        EmergencyResponseSystem system;
+        istringstream in(csv);
+        string line, place, severity, lat, lon;
+        getline(in, line); // header
+        while (getline(in, line)) {
+            istringstream row(line);
+            getline(row, place, ',');
+            getline(row, severity, ',');
+            getline(row, lat, ',');
+            getline(row, lon);
+            float c1 = stof(lat), c2 = stof(lon);
+            system.addIncident({place, static_cast<EmergencySeverity>(stoi(severity)), c1, c2});
+            ++streamRows;
+        }
+    }
+    double streamSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double maxFloatError = 0.0;
+    for (const auto& incident : source) {
+        float c1 = static_cast<float>(incident.latitude), c2 = static_cast<float>(incident.longitude);
+        maxFloatError = max(maxFloatError, haversineDistance(incident.latitude, incident.longitude, c1, c2) * 1000.0);
+    }
+
+    size_t domRows = 0;
+    start = chrono::steady_clock::now();
+    {
+        EmergencyResponseSystem system;
+        vector<EmergencyIncident> batch;
+        string error;
+        for (size_t begin = 0; begin < ndjson.size();) {
+            size_t end = ndjson.find('\n', begin);
+            nlohmann::json value = nlohmann::json::parse(ndjson.begin() + begin, ndjson.begin() + end, nullptr, false);
+            begin = end + 1;
+            batch.clear();
+            if (incidentFromJson(value, batch, error)) system.addIncidents(batch);
+        }
+        domRows = rows;
+    }
+    double domSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t csvRows, ndjsonRows;
+    double csvSeconds = replay(csv, csvRows);
+    double ndjsonSeconds = replay(ndjson, ndjsonRows);
+
+    auto report = [](const char* label, size_t count, double seconds, size_t bytes) {
+        cout << "  " << label << setw(7) << fixed << setprecision(2) << count / seconds / 1e6 << " M rows/s, "
+             << setw(6) << setprecision(0) << bytes / seconds / (1 << 20) << " MiB/s" << endl;
+    };
+    cout << "Incident replay, " << rows << " rows (CSV " << csv.size() / (1 << 20) << " MiB, NDJSON "
+         << ndjson.size() / (1 << 20) << " MiB)" << endl;
+    report("CSV, getline + stof:      ", streamRows, streamSeconds, csv.size());
+    report("CSV, IncidentReader:      ", csvRows, csvSeconds, csv.size());
+    report("NDJSON, nlohmann per row: ", domRows, domSeconds, ndjson.size());
+    report("NDJSON, IncidentReader:   ", ndjsonRows, ndjsonSeconds, ndjson.size());
+    cout << "  float coordinates are up to " << setprecision(2) << maxFloatError << " m off" << endl;
+    if (csvRows != rows || ndjsonRows != rows) cout << "  WARNING: rows lost (" << csvRows << ", " << ndjsonRows << ")" << endl;
+}
+
+// Live re-prioritisation under load: n queued incidents, then a steady mix
+// of arrivals, dispatches, escalations/downgrades and cancellations. The
+// baseline is std::priority_queue with lazy deletion (re-push on update,
+// skip stale entries on pop); both must dispatch in the same order.
+void benchIncidentQueue(size_t incidents) {
+    enum OpKind { PUSH, POP, UPDATE, CANCEL };
+    struct Op {
+        OpKind kind;
+        uint64_t id;
+        int severity;
+    };
+    srand(23);
+    auto severity = [] { return 1 + rand() % 4; };
+    vector<Op> script;
+    uint64_t pushed = 0;
+    for (size_t i = 0; i < incidents; ++i) script.push_back({PUSH, ++pushed, severity()});
+    for (size_t round = 0; round < 4 * incidents; ++round) {
+        uint64_t id = 1 + rand() % pushed;
+        script.push_back({UPDATE, id, severity()});
+        if (round % 2 == 0) {
+            script.push_back({POP, 0, 0});
+            script.push_back({PUSH, ++pushed, severity()});
+        }
+        if (round % 10 == 0) script.push_back({CANCEL, 1 + rand() % pushed, 0});
+    }
+    for (size_t i = 0; i < incidents; ++i) script.push_back({POP, 0, 0});
+
+    cout << "Incident queue, " << incidents << " queued, " << script.size() << " operations" << endl;
+    EmergencyIncident incident("Incident", OTHER_EMERGENCY, 28.63, 77.21);
+    vector<uint64_t> lazyOrder, indexedOrder; // by arrival number
+    {
+        using Key = tuple<int, uint64_t, uint32_t>; // severity, arrival, version
+        priority_queue<Key, vector<Key>, greater<Key>> heap;
+        vector<EmergencyIncident> stored; // the heap cannot hold them: their severity changes
+        stored.reserve(pushed + 1);
+        stored.push_back(incident);
+        vector<uint32_t> version(pushed + 1, 0);
+        vector<char> queued(pushed + 1, 0);
+        size_t peak = 0;
+        auto start = chrono::steady_clock::now();
+        for (const Op& op : script) {
+            if (op.kind == PUSH) {
+                incident.severity = static_cast<EmergencySeverity>(op.severity);
+                stored.push_back(incident);
+                queued[op.id] = 1;
+                heap.emplace(op.severity, op.id, version[op.id]);
+            } else if (op.kind == UPDATE) {
+                if (!queued[op.id]) continue;
+                stored[op.id].severity = static_cast<EmergencySeverity>(op.severity);
+                heap.emplace(op.severity, op.id, ++version[op.id]);
+            } else if (op.kind == CANCEL) {
+                queued[op.id] = 0;
+            } else {
+                while (!heap.empty() && (!queued[get<1>(heap.top())] || get<2>(heap.top()) != version[get<1>(heap.top())])) {
+                    heap.pop();
+                }
+                if (heap.empty()) continue;
+                lazyOrder.push_back(get<1>(heap.top()));
+                queued[get<1>(heap.top())] = 0;
+                heap.pop();
+            }
+            peak = max(peak, heap.size());
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "  priority_queue + lazy deletion: " << fixed << setprecision(2) << setw(8) << ms
+             << " ms, peak " << peak << " entries" << endl;
+    }
+    {
+        IncidentQueue queue;
+        vector<IncidentQueue::Id> idOf(1, 0);
+        unordered_map<IncidentQueue::Id, uint64_t> arrivalOf;
+        size_t peak = 0;
+        auto start = chrono::steady_clock::now();
+        for (const Op& op : script) {
+            if (op.kind == PUSH) {
+                incident.severity = static_cast<EmergencySeverity>(op.severity);
+                idOf.push_back(queue.push(incident));
+            } else if (op.kind == UPDATE) {
+                queue.setSeverity(idOf[op.id], static_cast<EmergencySeverity>(op.severity));
+            } else if (op.kind == CANCEL) {
+                queue.erase(idOf[op.id]);
+            } else if (!queue.empty()) {
+                indexedOrder.push_back(queue.topId());
+                queue.pop();
+            }
+            peak = max(peak, queue.size());
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "  indexed 4-ary heap:             " << fixed << setprecision(2) << setw(8) << ms
+             << " ms, peak " << peak << " entries" << endl;
+        for (size_t arrival = 1; arrival < idOf.size(); ++arrival) arrivalOf[idOf[arrival]] = arrival;
+        for (auto& id : indexedOrder) id = arrivalOf[id];
+    }
+    cout << "  same dispatch order: " << (lazyOrder == indexedOrder ? "yes" : "NO") << endl;
+}
+
+// Jittered street grid over Delhi with faster arterials every tenth row and
+// column; every street is two-way
+void syntheticRoadGrid(RoadNetwork& network, size_t side, unsigned seed = 11) {
+    srand(seed);
+    auto uniform = [](double lo, double hi) { return lo + (hi - lo) * rand() / RAND_MAX; };
+    const double latStep = (28.88 - 28.40) / side, lonStep = (77.35 - 76.84) / side;
+    vector<RoadNode> nodes;
+    nodes.reserve(side * side);
+    for (size_t r = 0; r < side; ++r) {
+        for (size_t c = 0; c < side; ++c) {
+            nodes.push_back({28.40 + (r + uniform(-0.3, 0.3)) * latStep,
+                             76.84 + (c + uniform(-0.3, 0.3)) * lonStep});
+        }
+    }
+
+    vector<RoadEdge> edges;
+    edges.reserve(4 * side * side);
+    auto connect = [&](uint32_t a, uint32_t b, bool arterial, const string& name) {
+        float meters = static_cast<float>(haversineDistance(nodes[a].latitude, nodes[a].longitude,
+                                                            nodes[b].latitude, nodes[b].longitude) * 1000.0);
+        float speed = static_cast<float>(arterial ? uniform(14.0, 17.0) : uniform(6.0, 10.0)); // m/s
+        edges.emplace_back(a, b, meters, meters / speed, name);
+        edges.emplace_back(b, a, meters, meters / speed, name);
+    };
+    for (size_t r = 0; r < side; ++r) {
+        for (size_t c = 0; c < side; ++c) {
+            uint32_t node = static_cast<uint32_t>(r * side + c);
+            if (c + 1 < side) {
+                connect(node, node + 1, r % 10 == 0, (r % 10 == 0 ? "Marg " : "Street ") + to_string(r));
+            }
+            if (r + 1 < side) {
+                connect(node, static_cast<uint32_t>(node + side), c % 10 == 0,
+                        (c % 10 == 0 ? "Road " : "Lane ") + to_string(c));
+            }
+        }
+    }
+    network.build(nodes, edges);
+}
+
+// Greedy nearest-unit claims versus the global assignment for a clustered
+// mass-casualty burst over a city-wide fleet
+void benchAssignment(size_t incidents, size_t units) {
+    srand(17);
+    auto uniform = [](double lo, double hi) { return lo + (hi - lo) * rand() / RAND_MAX; };
+    vector<EmergencyIncident> burst;
+    for (size_t i = 0; i < incidents; ++i) {
+        burst.emplace_back("Casualty_" + to_string(i), static_cast<EmergencySeverity>(1 + i % 4),
+                           uniform(28.60, 28.66), uniform(77.19, 77.25));
+    }
+    sort(burst.begin(), burst.end(), [](const EmergencyIncident& a, const EmergencyIncident& b) {
+        return a.severity < b.severity;
+    });
+
+    auto score = [&](const vector<pair<EmergencyIncident, GraphNode*>>& assignments, double seconds, const char* label) {
+        double weighted = 0.0, km = 0.0;
+        size_t missing = 0;
+        for (const auto& assignment : assignments) {
+            if (!assignment.second) {
+                ++missing;
+                continue;
+            }
+            double d = haversineDistance(assignment.first.latitude, assignment.first.longitude,
+                                         assignment.second->latitude, assignment.second->longitude);
+            km += d;
+            weighted += EmergencyResponseSystem::severityWeight(assignment.first.severity) * d;
+        }
+        cout << "  " << label << fixed << setprecision(1) << setw(10) << km << " km total, "
+             << setw(10) << weighted << " weighted, " << missing << " unassigned, "
+             << setprecision(2) << seconds * 1000 << " ms" << endl;
+    };
+
+    cout << "Assignment of " << incidents << " clustered incidents to " << units << " units" << endl;
+    {
+        EmergencyResponseSystem system(syntheticFleet(units));
+        vector<pair<EmergencyIncident, GraphNode*>> assignments;
+        auto start = chrono::steady_clock::now();
+        for (const auto& incident : burst) assignments.emplace_back(incident, system.claimResource(incident));
+        score(assignments, chrono::duration<double>(chrono::steady_clock::now() - start).count(), "greedy:  ");
+    }
+    {
+        EmergencyResponseSystem system(syntheticFleet(units));
+        auto start = chrono::steady_clock::now();
+        auto assignments = system.assignUnits(burst);
+        score(assignments, chrono::duration<double>(chrono::steady_clock::now() - start).count(), "optimal: ");
+    }
+}
+
+// Straight-line nearest versus best-of-k by travel time on a synthetic road
+// grid, and what the batched travel-time query saves over k separate routes
+void benchEtaSelection(size_t incidents, size_t k = 8) {
+    RoadNetwork network;
+    syntheticRoadGrid(network, 120);
+    network.contract();
+    LocalRouter router(network);
+
+    EmergencyResponseSystem system(syntheticFleet(3000));
+    system.setLocalRouter(&router);
+    vector<EmergencyIncident> burst = syntheticIncidents(incidents);
+
+    size_t changed = 0, compared = 0;
+    double nearestEta = 0.0, rankedEta = 0.0, routesUs = 0.0, tableUs = 0.0;
+    for (const auto& incident : burst) {
+        system.setEtaCandidates(1);
+        vector<GraphNode*> nearest = system.rankByTravelTime(incident);
+        system.setEtaCandidates(k);
+        vector<GraphNode*> ranked = system.rankByTravelTime(incident);
+        if (nearest.empty() || ranked.empty()) continue;
+
+        auto start = chrono::steady_clock::now();
+        vector<double> seconds = system.travelTimesTo(ranked, incident);
+        auto middle = chrono::steady_clock::now();
+        for (const GraphNode* unit : ranked) {
+            router.route(unit->latitude, unit->longitude, incident.latitude, incident.longitude);
+        }
+        auto end = chrono::steady_clock::now();
+        tableUs += chrono::duration<double, micro>(middle - start).count();
+        routesUs += chrono::duration<double, micro>(end - middle).count();
+
+        double best = seconds[0];
+        double straight = system.travelTimesTo(nearest, incident)[0];
+        if (isinf(best) || isinf(straight)) continue;
+        ++compared;
+        changed += ranked[0] != nearest[0];
+        nearestEta += straight;
+        rankedEta += best;
+    }
+
+    cout << "ETA-ranked selection over " << k << " candidates, " << compared << " incidents, "
+         << network.nodeCount << "-node road grid" << endl;
+    cout << fixed << setprecision(1);
+    cout << "  picked a different unit than straight-line nearest: " << 100.0 * changed / max<size_t>(compared, 1) << "%" << endl;
+    cout << "  mean ETA: nearest " << nearestEta / max<size_t>(compared, 1) << " s, best of " << k << " "
+         << rankedEta / max<size_t>(compared, 1) << " s" << endl;
+    cout << "  local: " << k << " routes " << routesUs / max<size_t>(compared, 1) << " us, one many-to-one search "
+         << tableUs / max<size_t>(compared, 1) << " us" << endl;
+
+    const int roundTripMs = 20;
+    LocalOsrmStandIn standIn(roundTripMs);
+    OsrmClient client(standIn.url());
+    const EmergencyIncident& incident = burst[0];
+    vector<pair<double, double>> sources;
+    for (size_t i = 0; i < k; ++i) sources.emplace_back(28.5 + 0.01 * i, 77.1 + 0.01 * i);
+    auto start = chrono::steady_clock::now();
+    for (const auto& source : sources) client.route(source.first, source.second, incident.latitude, incident.longitude);
+    auto middle = chrono::steady_clock::now();
+    client.travelTimes(sources, incident.latitude, incident.longitude);
+    auto end = chrono::steady_clock::now();
+    cout << "  OSRM stand-in (" << roundTripMs << " ms): " << k << " /route requests "
+         << chrono::duration<double, milli>(middle - start).count() << " ms, one /table request "
+         << chrono::duration<double, milli>(end - middle).count() << " ms" << endl;
+}
+
+// Cost of a StageTimer lap with recording off and on, then the per-stage
+// report for a burst dispatched by 4 workers against the local OSRM stand-in
+void benchStageLatency(size_t incidents) {
+    LatencyRecorder& latency = sharedLatencyRecorder();
+    const size_t laps = 10000000;
+    double seconds[2], clockSeconds;
+    for (int on = 0; on < 2; ++on) {
+        latency.enable(on);
+        auto start = chrono::steady_clock::now();
+        StageTimer timer;
+        for (size_t i = 0; i < laps; ++i) timer.lap(STAGE_CLAIM);
+        seconds[on] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    auto clockStart = chrono::steady_clock::now();
+    for (size_t i = 0; i < laps; ++i) LatencyRecorder::now();
+    clockSeconds = chrono::duration<double>(chrono::steady_clock::now() - clockStart).count();
+    latency.reset();
+
+    LocalOsrmStandIn standIn;
+    OsrmClient client(standIn.url());
+    EmergencyResponseSystem system(syntheticFleet(incidents + 1000));
+    system.setRoutingClient(client);
+    system.setRouteCache(nullptr);
+    {
+        DispatcherEngine engine(system, 4, [](IncidentQueue::Id, string_view) {});
+        engine.submitAll(syntheticIncidents(incidents));
+        engine.waitIdle();
+    }
+    latency.enable(false);
+
+    cout << "Stage laps: " << fixed << setprecision(1) << seconds[0] * 1e9 / laps << " ns off, "
+         << seconds[1] * 1e9 / laps << " ns recording, of which " << clockSeconds * 1e9 / laps
+         << " ns is the clock read" << endl;
+    cout << "Burst of " << incidents << " incidents, 4 workers, OSRM stand-in" << endl << latency.report();
+}
+
+// Heap allocations per dispatch (claim, route, parse, report) with the
+// route cache off, scratch on the heap versus in a DispatchArena, against
+// the OSRM stand-in and the local router. Counts are operator new calls on
+// the dispatching thread; curl's own mallocs are not included.
+void benchDispatchArena(size_t incidents) {
+    LocalOsrmStandIn standIn;
+    OsrmClient client(standIn.url());
+    RoadNetwork network;
+    syntheticRoadGrid(network, 120);
+    network.contract();
+    LocalRouter router(network);
+    vector<EmergencyIncident> burst = syntheticIncidents(incidents);
+
+    cout << "Allocations per dispatch, " << incidents << " incidents, route cache off" << endl;
+    for (int local = 0; local < 2; ++local) {
+        EmergencyResponseSystem system(syntheticFleet(3000));
+        system.setRoutingClient(client);
+        system.setRouteCache(nullptr);
+        if (local) system.setLocalRouter(&router);
+
+        for (int useArena = 0; useArena < 2; ++useArena) {
+            DispatchArena arena;
+            size_t allocations = 0;
+            double seconds = 0.0;
+            for (size_t i = 0; i < burst.size() + 10; ++i) {
+                const EmergencyIncident& incident = burst[i % burst.size()];
+                size_t before = heapAllocations();
+                auto start = chrono::steady_clock::now();
+                {
+                    pmr::memory_resource* memory = useArena ? arena.memory() : pmr::get_default_resource();
+                    pmr::string report(memory);
+                    uint32_t token;
+                    GraphNode* unit = system.claimResource(incident, &token);
+                    if (unit) {
+                        RoutePtr route = system.routeFor(*unit, incident, memory);
+                        system.renderDispatchReport(report, incident, unit, route.get(), memory);
+                        system.releaseResource(*unit, token);
+                    }
+                }
+                arena.reset();
+                if (i < 10) continue; // warm-up: connection, workspaces, arena size
+                seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                allocations += heapAllocations() - before;
+            }
+            cout << "  " << (local ? "local router" : "OSRM stand-in") << ", " << (useArena ? "arena: " : "heap:  ")
+                 << fixed << setprecision(1) << setw(8) << static_cast<double>(allocations) / incidents
+                 << " allocations, " << setw(8) << seconds * 1e6 / incidents << " us/dispatch";
+            if (useArena) cout << " (arena " << arena.bytes() / 1024 << " KiB, grown " << arena.timesGrown() << "x)";
+            cout << endl;
+        }
+    }
+}
+
+// Latency of in-process routes between random points, with the contraction
+// hierarchy and with plain bidirectional A*
+void benchLocalRouting(size_t side, const string& path = "") {
+    RoadNetwork network;
+    auto loadStart = chrono::steady_clock::now();
+    if (!path.empty()) {
+        if (!network.open(path)) return;
+    } else {
+        syntheticRoadGrid(network, side);
+    }
+    double loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count();
+
+    const size_t queries = 2000;
+    vector<EmergencyIncident> points = syntheticIncidents(2 * queries);
+    auto timeRoutes = [&](const char* label) {
+        LocalRouter router(network);
+        router.route(points[0].latitude, points[0].longitude, points[1].latitude, points[1].longitude);
+        size_t steps = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < queries; ++i) {
+            const EmergencyIncident& from = points[2 * i];
+            const EmergencyIncident& to = points[2 * i + 1];
+            steps += router.route(from.latitude, from.longitude, to.latitude, to.longitude).steps.size();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "  " << label << setw(9) << fixed << setprecision(1) << seconds * 1e6 / queries
+             << " us per route, " << static_cast<double>(steps) / queries << " steps on average" << endl;
+    };
+
+    cout << "Road network: " << network.nodeCount << " nodes, " << network.edgeCount << " edges, loaded in "
+         << fixed << setprecision(1) << loadMs << " ms" << endl;
+    if (!network.hasHierarchy()) {
+        timeRoutes("bidirectional A*: ");
+        auto contractStart = chrono::steady_clock::now();
+        network.contract();
+        cout << "  contracted in " << chrono::duration<double, milli>(chrono::steady_clock::now() - contractStart).count()
+             << " ms, " << network.arcCount << " arcs" << endl;
+    }
+    timeRoutes("hierarchy:        ");
+}
+
+int main(int argc, char* argv[]) {
+    string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--bench-routing") {
+        benchRouting(argc > 2 ? max(1, atoi(argv[2])) : 500);
+        return 0;
+    }
+    if (mode == "--bench-parse") {
+        benchRouteParsing(argc > 2 ? max(1, atoi(argv[2])) : 20000);
+        return 0;
+    }
+    if (mode == "--bench-report") {
+        benchReportRendering(argc > 2 ? max(1, atoi(argv[2])) : 20000);
+        return 0;
+    }
+    if (mode == "--bench-batch") {
+        benchBatchedDispatch(argc > 2 ? max(1, atoi(argv[2])) : 100);
+        return 0;
+    }
+    if (mode == "--bench-haversine") {
+        benchBatchHaversine(argc > 2 ? max(1, atoi(argv[2])) : 4096);
+        return 0;
+    }
+    if (mode == "--bench-nearest") {
+        benchNearestUnit(argc > 2 ? max(1, atoi(argv[2])) : 50000);
+        return 0;
+    }
+    if (mode == "--bench-station-graph") {
+        benchStationGraph(argc > 2 ? max(1, atoi(argv[2])) : 100000);
+        return 0;
+    }
+    if (mode == "--bench-mutual-aid") {
+        benchMutualAid(argc > 2 ? max(1, atoi(argv[2])) : 100000, argc > 3 ? max(1.0, atof(argv[3])) : 50.0);
+        return 0;
+    }
+    if (mode == "--bench-ingest") {
+        benchIncidentIngest(argc > 2 ? max(1, atoi(argv[2])) : 20000);
+        return 0;
+    }
+    if (mode == "--bench-replay") {
+        benchIncidentReplay(argc > 2 ? max(1, atoi(argv[2])) : 1000000);
+        return 0;
+    }
+    if (mode == "--bench-latency") {
+        benchStageLatency(argc > 2 ? max(1, atoi(argv[2])) : 2000);
+        return 0;
+    }
+    if (mode == "--bench-claim") {
+        benchClaimContention(argc > 2 ? max(1, atoi(argv[2])) : 3000);
+        return 0;
+    }
+    if (mode == "--bench-workers") {
+        benchDispatchWorkers(argc > 2 ? max(1, atoi(argv[2])) : 200);
+        return 0;
+    }
+    if (mode == "--bench-arena") {
+        benchDispatchArena(argc > 2 ? max(1, atoi(argv[2])) : 500);
+        return 0;
+    }
+    if (mode == "--bench-queue") {
+        benchIncidentQueue(argc > 2 ? max(1, atoi(argv[2])) : 100000);
+        return 0;
+    }
+    if (mode == "--bench-assign") {
+        benchAssignment(argc > 2 ? max(1, atoi(argv[2])) : 300, argc > 3 ? max(1, atoi(argv[3])) : 3000);
+        return 0;
+    }
+    if (mode == "--bench-eta") {
+        benchEtaSelection(argc > 2 ? max(1, atoi(argv[2])) : 500, argc > 3 ? max(2, atoi(argv[3])) : 8);
+        return 0;
+    }
+    if (mode == "--bench-local-route") {
+        string arg = argc > 2 ? argv[2] : "";
+        bool isSize = !arg.empty() && arg.find_first_not_of("0123456789") == string::npos;
+        benchLocalRouting(isSize ? max(2, atoi(arg.c_str())) : 300, isSize ? "" : arg);
+        return 0;
+    }
+
+    cerr << "Usage: " << argv[0] << " --bench-<name> [arguments]; see README.md for the list" << endl;
+    return 1;
+}
@@ -0,0 +1,1779 @@
+// Unit tests for the dispatcher. Each TEST registers itself; a failed CHECK
+// is reported and the test carries on. Build and run (an argument runs only
+// the tests whose name contains it):
+//   g++ -std=c++17 -O2 -o ers_tests.exe tests.cpp -I. -lcurl && ./ers_tests.exe
+#define ERS_NO_MAIN
+#include "FINAL.CPP"
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+vector<TestCase>& testCases() {
+    static vector<TestCase> cases;
+    return cases;
+}
+
+int failedChecks = 0;
+
+#define TEST(name)                                                               \
+    void name();                                                                 \
+    const bool name##Registered = (testCases().push_back({#name, name}), true);  \
+    void name()
+
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition)) {                                                                  \
+            ++failedChecks;                                                                  \
+            cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << endl; \
+        }                                                                                    \
+    } while (0)
+
+// Keeps expected complaints off cerr while in scope
+class CerrSilencer {
+private:
+    ostringstream sink;
+    streambuf* previous;
+
+public:
+    CerrSilencer() : previous(cerr.rdbuf(sink.rdbuf())) {}
+    ~CerrSilencer() { cerr.rdbuf(previous); }
+};
+
+// ---- IncidentQueue ----
+
+TEST(incidentQueueOrdersBySeverityThenArrival) {
+    IncidentQueue queue;
+    queue.emplace("crime 1", CRIME, 0.0, 0.0);
+    queue.emplace("fire 1", FIRE, 0.0, 0.0);
+    queue.emplace("other", OTHER_EMERGENCY, 0.0, 0.0);
+    queue.emplace("fire 2", FIRE, 0.0, 0.0);
+    queue.emplace("medical", MEDICAL_EMERGENCY, 0.0, 0.0);
+    queue.emplace("crime 2", CRIME, 0.0, 0.0);
+
+    vector<string> order;
+    while (!queue.empty()) order.emplace_back(queue.take().place.str());
+    CHECK((order == vector<string>{"fire 1", "fire 2", "medical", "crime 1", "crime 2", "other"}));
+}
+
+TEST(incidentQueueSeverityChangesKeepArrivalOrder) {
+    IncidentQueue queue;
+    IncidentQueue::Id first = queue.emplace("first", CRIME, 0.0, 0.0);
+    queue.emplace("second", FIRE, 0.0, 0.0);
+    IncidentQueue::Id third = queue.emplace("third", MEDICAL_EMERGENCY, 0.0, 0.0);
+    queue.emplace("fourth", FIRE, 0.0, 0.0);
+
+    // Escalated to FIRE, "first" arrived before both fires; "third" drops behind
+    CHECK(queue.setSeverity(first, FIRE));
+    CHECK(queue.setSeverity(third, OTHER_EMERGENCY));
+    CHECK(queue.top().severity == FIRE);
+    CHECK(queue.topId() == first);
+
+    vector<string> order;
+    while (!queue.empty()) order.emplace_back(queue.take().place.str());
+    CHECK((order == vector<string>{"first", "second", "fourth", "third"}));
+}
+
+TEST(incidentQueueEraseAndStaleIds) {
+    IncidentQueue queue;
+    IncidentQueue::Id a = queue.emplace("a", FIRE, 0.0, 0.0);
+    IncidentQueue::Id b = queue.emplace("b", CRIME, 0.0, 0.0);
+    CHECK(queue.erase(b));
+    CHECK(!queue.contains(b));
+    CHECK(!queue.erase(b));
+    CHECK(!queue.setSeverity(b, FIRE));
+    CHECK(queue.size() == 1);
+
+    // b's slot is reused, but the old ID must not find the new incident
+    IncidentQueue::Id c = queue.emplace("c", MEDICAL_EMERGENCY, 0.0, 0.0);
+    CHECK(c != b);
+    CHECK(!queue.contains(b));
+    CHECK(queue.contains(c));
+
+    queue.pop();
+    CHECK(!queue.contains(a));
+    CHECK(queue.topId() == c);
+}
+
+// Random pushes, pops, severity changes and erasures against a sorted model
+TEST(incidentQueueMatchesReferenceModel) {
+    mt19937 random(17);
+    IncidentQueue queue;
+    map<pair<int, uint64_t>, IncidentQueue::Id> model; // (severity, arrival) -> id
+    map<IncidentQueue::Id, pair<int, uint64_t>> keyOf;
+    uint64_t arrival = 0;
+    bool consistent = true;
+
+    for (int step = 0; step < 20000; ++step) {
+        int op = random() % 10;
+        if (op < 4 || model.empty()) {
+            EmergencySeverity severity = static_cast<EmergencySeverity>(1 + random() % 4);
+            IncidentQueue::Id id = queue.emplace("x", severity, 0.0, 0.0);
+            model[{severity, arrival}] = id;
+            keyOf[id] = {severity, arrival++};
+        } else if (op < 6) {
+            IncidentQueue::Id expected = model.begin()->second;
+            consistent = consistent && queue.topId() == expected &&
+                         queue.top().severity == model.begin()->first.first;
+            queue.pop();
+            keyOf.erase(expected);
+            model.erase(model.begin());
+        } else {
+            auto it = keyOf.begin();
+            advance(it, random() % keyOf.size());
+            IncidentQueue::Id id = it->first;
+            model.erase(it->second);
+            if (op < 8) {
+                EmergencySeverity severity = static_cast<EmergencySeverity>(1 + random() % 4);
+                consistent = consistent && queue.setSeverity(id, severity);
+                it->second.first = severity;
+                model[it->second] = id;
+            } else {
+                consistent = consistent && queue.erase(id);
+                keyOf.erase(it);
+            }
+        }
+        consistent = consistent && queue.size() == model.size();
+    }
+    CHECK(consistent);
+    while (!queue.empty() && consistent) {
+        consistent = queue.topId() == model.begin()->second;
+        queue.pop();
+        model.erase(model.begin());
+    }
+    CHECK(consistent);
+}
+
+// ---- SparseAssignment ----
+
+// Cheapest total over every way of giving each row one of its options or
+// leaving it unassigned, with no column used twice
+double bruteForceAssignment(const vector<vector<SparseAssignment::Option>>& options,
+                            const vector<double>& unassignedCost, size_t row, vector<char>& used) {
+    if (row == options.size()) return 0.0;
+    double best = unassignedCost[row] + bruteForceAssignment(options, unassignedCost, row + 1, used);
+    for (const auto& option : options[row]) {
+        if (used[option.column]) continue;
+        used[option.column] = 1;
+        best = min(best, option.cost + bruteForceAssignment(options, unassignedCost, row + 1, used));
+        used[option.column] = 0;
+    }
+    return best;
+}
+
+// Total cost of the solver's answer, or -1 if it is not a valid assignment
+double assignmentCost(const SparseAssignment& assignment, const vector<vector<SparseAssignment::Option>>& options,
+                      const vector<double>& unassignedCost, size_t columns) {
+    vector<char> used(columns, 0);
+    double total = 0.0;
+    for (uint32_t row = 0; row < options.size(); ++row) {
+        uint32_t column = assignment.column(row);
+        if (column == SparseAssignment::NONE) {
+            total += unassignedCost[row];
+            continue;
+        }
+        auto option = find_if(options[row].begin(), options[row].end(),
+                              [&](const SparseAssignment::Option& o) { return o.column == column; });
+        if (option == options[row].end() || used[column]) return -1.0;
+        used[column] = 1;
+        total += option->cost;
+    }
+    return total;
+}
+
+TEST(sparseAssignmentMatchesBruteForce) {
+    mt19937 random(5);
+    int mismatches = 0;
+    for (int trial = 0; trial < 500; ++trial) {
+        size_t rows = 1 + random() % 6, columns = 1 + random() % 6;
+        SparseAssignment assignment;
+        for (size_t c = 0; c < columns; ++c) assignment.addColumn();
+
+        vector<vector<SparseAssignment::Option>> options(rows);
+        vector<double> unassignedCost(rows);
+        for (size_t r = 0; r < rows; ++r) {
+            for (uint32_t c = 0; c < columns; ++c) {
+                if (random() % 3 == 0) continue;
+                options[r].push_back({c, static_cast<double>(random() % 100)});
+            }
+            unassignedCost[r] = 50.0 + random() % 100;
+            assignment.addRow(options[r], unassignedCost[r]);
+        }
+        assignment.solve();
+
+        vector<char> used(columns, 0);
+        double expected = bruteForceAssignment(options, unassignedCost, 0, used);
+        double actual = assignmentCost(assignment, options, unassignedCost, columns);
+        mismatches += fabs(actual - expected) > 1e-9;
+    }
+    CHECK(mismatches == 0);
+}
+
+// Rows left unassigned get more options and are re-solved incrementally
+TEST(sparseAssignmentAddOptionsMatchesBruteForce) {
+    mt19937 random(9);
+    int mismatches = 0;
+    for (int trial = 0; trial < 300; ++trial) {
+        size_t rows = 2 + random() % 5, columns = 2 + random() % 5;
+        SparseAssignment assignment;
+        for (size_t c = 0; c < columns; ++c) assignment.addColumn();
+
+        // Start every row on one option, then offer the rest to whoever is left out
+        vector<vector<SparseAssignment::Option>> options(rows), later(rows);
+        vector<double> unassignedCost(rows);
+        for (size_t r = 0; r < rows; ++r) {
+            for (uint32_t c = 0; c < columns; ++c) {
+                SparseAssignment::Option option{c, static_cast<double>(random() % 100)};
+                (options[r].empty() ? options[r] : later[r]).push_back(option);
+            }
+            unassignedCost[r] = 100.0 + random() % 100;
+            assignment.addRow(options[r], unassignedCost[r]);
+        }
+        assignment.solve();
+        for (uint32_t r = 0; r < rows; ++r) {
+            if (assignment.column(r) != SparseAssignment::NONE) continue;
+            assignment.addOptions(r, later[r]);
+            options[r].insert(options[r].end(), later[r].begin(), later[r].end());
+        }
+        assignment.solve();
+
+        // Rows that kept their first option never saw the others
+        vector<char> used(columns, 0);
+        double expected = bruteForceAssignment(options, unassignedCost, 0, used);
+        double actual = assignmentCost(assignment, options, unassignedCost, columns);
+        mismatches += fabs(actual - expected) > 1e-9;
+    }
+    CHECK(mismatches == 0);
+}
+
+// ---- LocalRouter ----
+
+// A random sparse one-way street network; some nodes end up unreachable
+void randomRoadNetwork(mt19937& random, size_t nodeCount, vector<RoadNode>& nodes, vector<RoadEdge>& edges) {
+    uniform_real_distribution<double> lat(28.50, 28.70), lon(77.10, 77.30), detour(1.0, 1.6), speed(5.0, 30.0);
+    nodes.clear();
+    edges.clear();
+    for (size_t i = 0; i < nodeCount; ++i) nodes.push_back({lat(random), lon(random)});
+    for (size_t i = 0; i < 3 * nodeCount; ++i) {
+        uint32_t from = random() % nodeCount, to = random() % nodeCount;
+        if (from == to) continue;
+        double meters = haversineDistance(nodes[from].latitude, nodes[from].longitude,
+                                          nodes[to].latitude, nodes[to].longitude) * 1000.0 * detour(random);
+        edges.emplace_back(from, to, static_cast<float>(meters), static_cast<float>(meters / speed(random)),
+                           "Street " + to_string(i % 7));
+    }
+}
+
+// Plain Dijkstra on edge durations from `source`, forwards or backwards
+vector<double> referenceTravelTimes(size_t nodeCount, const vector<RoadEdge>& edges, uint32_t source, bool reverse) {
+    vector<vector<pair<uint32_t, double>>> adjacency(nodeCount);
+    for (const RoadEdge& edge : edges) {
+        if (reverse) adjacency[edge.to].emplace_back(edge.from, edge.duration);
+        else adjacency[edge.from].emplace_back(edge.to, edge.duration);
+    }
+    vector<double> distance(nodeCount, numeric_limits<double>::infinity());
+    priority_queue<pair<double, uint32_t>, vector<pair<double, uint32_t>>, greater<pair<double, uint32_t>>> heap;
+    distance[source] = 0.0;
+    heap.emplace(0.0, source);
+    while (!heap.empty()) {
+        auto [d, u] = heap.top();
+        heap.pop();
+        if (d > distance[u]) continue;
+        for (auto [v, w] : adjacency[u]) {
+            if (d + w < distance[v]) {
+                distance[v] = d + w;
+                heap.emplace(distance[v], v);
+            }
+        }
+    }
+    return distance;
+}
+
+double routeDuration(const Route& route) {
+    double total = 0.0;
+    for (const RouteStep& step : route.steps) total += step.duration;
+    return total;
+}
+
+bool sameTime(double a, double b) {
+    if (isinf(a) || isinf(b)) return isinf(a) && isinf(b);
+    return fabs(a - b) <= 1e-6 * max(1.0, b);
+}
+
+// A* on the plain network and the contraction hierarchy both find the
+// Dijkstra travel time, or both find no route
+TEST(localRouterHierarchyAndAStarMatchDijkstra) {
+    mt19937 random(23);
+    int mismatches = 0, routed = 0;
+    for (int trial = 0; trial < 20; ++trial) {
+        vector<RoadNode> nodes;
+        vector<RoadEdge> edges;
+        randomRoadNetwork(random, 40 + random() % 60, nodes, edges);
+        RoadNetwork plain, contracted;
+        plain.build(nodes, edges);
+        contracted.build(nodes, edges);
+        contracted.contract();
+        CHECK(!plain.hasHierarchy());
+        CHECK(contracted.hasHierarchy());
+        LocalRouter aStar(plain), hierarchy(contracted);
+
+        for (int query = 0; query < 30; ++query) {
+            uint32_t source = random() % nodes.size(), target = random() % nodes.size();
+            double expected = referenceTravelTimes(nodes.size(), edges, source, false)[target];
+            for (const LocalRouter* router : {&aStar, &hierarchy}) {
+                Route route = router->route(nodes[source].latitude, nodes[source].longitude,
+                                           nodes[target].latitude, nodes[target].longitude);
+                double actual = route.ok() ? routeDuration(route) : numeric_limits<double>::infinity();
+                mismatches += !sameTime(actual, expected);
+            }
+            routed += !isinf(expected);
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(routed > 0);
+}
+
+// Many-to-one travel times agree with a backward Dijkstra from the destination
+TEST(localRouterTravelTimesMatchDijkstra) {
+    mt19937 random(29);
+    int mismatches = 0;
+    for (int trial = 0; trial < 20; ++trial) {
+        vector<RoadNode> nodes;
+        vector<RoadEdge> edges;
+        randomRoadNetwork(random, 40 + random() % 60, nodes, edges);
+        RoadNetwork plain, contracted;
+        plain.build(nodes, edges);
+        contracted.build(nodes, edges);
+        contracted.contract();
+        LocalRouter aStar(plain), hierarchy(contracted);
+
+        uint32_t destination = random() % nodes.size();
+        vector<double> expected = referenceTravelTimes(nodes.size(), edges, destination, true);
+        vector<pair<double, double>> sources;
+        vector<uint32_t> sourceNodes;
+        for (int i = 0; i < 12; ++i) {
+            sourceNodes.push_back(random() % nodes.size());
+            sources.emplace_back(nodes[sourceNodes.back()].latitude, nodes[sourceNodes.back()].longitude);
+        }
+        for (const LocalRouter* router : {&aStar, &hierarchy}) {
+            vector<double> times = router->travelTimes(sources, nodes[destination].latitude, nodes[destination].longitude);
+            CHECK(times.size() == sources.size());
+            for (size_t i = 0; i < times.size() && i < sources.size(); ++i) {
+                mismatches += !sameTime(times[i], expected[sourceNodes[i]]);
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+// ---- RoadNetwork binary files ----
+
+string readFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+void writeFile(const string& path, const string& bytes) {
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+}
+
+// Whether mapBinary accepts `bytes`, with its complaint kept off cerr
+bool mapsCleanly(const string& bytes) {
+    const string path = "ers_tests_corrupt.bin";
+    writeFile(path, bytes);
+    bool mapped;
+    {
+        CerrSilencer silence;
+        RoadNetwork network;
+        mapped = network.mapBinary(path);
+    }
+    remove(path.c_str());
+    return mapped;
+}
+
+TEST(mappedRoadNetworkRoutesLikeTheOriginal) {
+    mt19937 random(31);
+    vector<RoadNode> nodes;
+    vector<RoadEdge> edges;
+    randomRoadNetwork(random, 80, nodes, edges);
+    RoadNetwork original;
+    original.build(nodes, edges);
+    original.contract();
+    const string path = "ers_tests_road.bin";
+    CHECK(original.writeBinary(path));
+    {
+        RoadNetwork mapped;
+        CHECK(mapped.mapBinary(path));
+        CHECK(mapped.isMapped() && mapped.verifyChecksum());
+        CHECK(mapped.nodeCount == original.nodeCount && mapped.arcCount == original.arcCount);
+        LocalRouter before(original), after(mapped);
+        int mismatches = 0;
+        for (int query = 0; query < 50; ++query) {
+            uint32_t source = random() % nodes.size(), target = random() % nodes.size();
+            Route a = before.route(nodes[source].latitude, nodes[source].longitude, nodes[target].latitude, nodes[target].longitude);
+            Route b = after.route(nodes[source].latitude, nodes[source].longitude, nodes[target].latitude, nodes[target].longitude);
+            mismatches += a.status != b.status || a.steps.size() != b.steps.size() || routeDuration(a) != routeDuration(b);
+        }
+        CHECK(mismatches == 0);
+    }
+    remove(path.c_str());
+}
+
+// Damaged headers, truncation and every index section holding an
+// out-of-range value are refused at map time; damaged weights are left to
+// verifyChecksum()
+TEST(mapBinaryRejectsCorruptFiles) {
+    mt19937 random(37);
+    vector<RoadNode> nodes;
+    vector<RoadEdge> edges;
+    randomRoadNetwork(random, 80, nodes, edges);
+    RoadNetwork network;
+    network.build(nodes, edges);
+    network.contract();
+    const string path = "ers_tests_road.bin";
+    CHECK(network.writeBinary(path));
+    const string good = readFile(path);
+    remove(path.c_str());
+    RoadGraphHeader header;
+    CHECK(good.size() > sizeof(header));
+    if (good.size() <= sizeof(header)) return;
+    memcpy(&header, good.data(), sizeof(header));
+    CHECK(mapsCleanly(good));
+
+    string bytes = good;
+    bytes[0] = 'X';
+    CHECK(!mapsCleanly(bytes));
+    bytes = good;
+    bytes[offsetof(RoadGraphHeader, nodeCount)] ^= 1; // caught by the header checksum
+    CHECK(!mapsCleanly(bytes));
+    CHECK(!mapsCleanly(good.substr(0, good.size() - 8)));
+    CHECK(!mapsCleanly(good.substr(0, sizeof(header) / 2)));
+
+    // Every uint32 section, as (index in RoadNetwork::forEachSection order,
+    // element count); the first and the last element of each are damaged
+    uint32_t n = header.nodeCount, e = header.edgeCount;
+    const pair<uint32_t, uint64_t> indexSections[] = {
+        {2, n + 1}, {3, e}, {6, e}, {7, n + 1}, {8, e}, {9, e}, {10, header.nameCount + 1},
+        {12, uint64_t(header.gridRows) * header.gridCols + 1}, {13, n}, {14, n + 1}, {15, header.upCount},
+        {17, header.upCount}, {18, n + 1}, {19, header.downCount}, {21, header.downCount},
+        {22, header.arcCount}, {23, header.arcCount}};
+    for (const auto& [section, count] : indexSections) {
+        CHECK(count > 0);
+        for (uint64_t element : {uint64_t(0), count - 1}) {
+            uint64_t at = header.sectionOffset[section] + element * sizeof(uint32_t);
+            bytes = good;
+            const uint32_t outOfRange = 0xFFFFFF00u;
+            memcpy(&bytes[at], &outOfRange, sizeof(outOfRange));
+            bool mapped = mapsCleanly(bytes);
+            if (mapped) cerr << "  section " << section << " element " << element << " was accepted" << endl;
+            CHECK(!mapped);
+        }
+    }
+
+    // A damaged duration still maps, but fails the payload checksum
+    bytes = good;
+    bytes[header.sectionOffset[5]] ^= 0x40;
+    writeFile(path, bytes);
+    {
+        RoadNetwork damaged;
+        CHECK(damaged.mapBinary(path));
+        CHECK(!damaged.verifyChecksum());
+    }
+    remove(path.c_str());
+}
+
+// ---- IncidentReader ----
+
+struct ReadResult {
+    vector<EmergencyIncident> incidents;
+    size_t rows = 0, rejected = 0, batches = 0;
+};
+
+// Runs `text` through an IncidentReader in pieces of `chunk` bytes
+ReadResult readIncidents(const string& text, size_t chunk) {
+    ReadResult result;
+    CerrSilencer silence;
+    IncidentReader reader("test", [&result](const vector<EmergencyIncident>& batch) {
+        result.incidents.insert(result.incidents.end(), batch.begin(), batch.end());
+        ++result.batches;
+    });
+    for (size_t at = 0; at < text.size(); at += chunk) reader.append(text.data() + at, min(chunk, text.size() - at));
+    reader.finish();
+    result.rows = reader.rowCount();
+    result.rejected = reader.rejectedCount();
+    return result;
+}
+
+bool sameIncidents(const vector<EmergencyIncident>& a, const vector<EmergencyIncident>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].place.str() != b[i].place.str() || a[i].severity != b[i].severity ||
+            a[i].latitude != b[i].latitude || a[i].longitude != b[i].longitude) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Header row, CRLF endings, quoting, blank lines, named severities, a last
+// row without its newline, and rows that must be rejected; the result must
+// not depend on where the reads split the text
+TEST(incidentReaderCsvRowsAndErrors) {
+    const string text =
+        "place,severity,lat,lon\r\n"
+        "Connaught Place,1,28.6300,77.2170\r\n"
+        "\r\n"
+        "\"Karol Bagh, Block 5\",medical, 28.6517 , 77.1910\r\n"
+        "\"The \"\"Old\"\" Fort\",crime,28.6097,77.2437\n"
+        "   \n"
+        "Too,few,fields\r\n"
+        "Bad severity,7,28.6,77.2\r\n"
+        "Bad lat,1,abc,77.2\r\n"
+        "Infinite,2,inf,77.2\r\n"
+        "Extra,1,28.6,77.2,more\r\n"
+        "\"Unterminated,1,28.6,77.2\r\n"
+        "\"Quoted\" trailing,1,28.6,77.2\r\n"
+        "Dwarka,other,28.5971,77.0582";
+    const vector<EmergencyIncident> expected = {
+        {"Connaught Place", FIRE, 28.6300, 77.2170},
+        {"Karol Bagh, Block 5", MEDICAL_EMERGENCY, 28.6517, 77.1910},
+        {"The \"Old\" Fort", CRIME, 28.6097, 77.2437},
+        {"Dwarka", OTHER_EMERGENCY, 28.5971, 77.0582}};
+
+    for (size_t chunk : {text.size(), size_t(1), size_t(2), size_t(7), size_t(64)}) {
+        ReadResult result = readIncidents(text, chunk);
+        CHECK(sameIncidents(result.incidents, expected));
+        CHECK(result.rows == expected.size());
+        CHECK(result.rejected == 7);
+    }
+}
+
+// Without a header the first row is data; a bad first row is taken for a header
+TEST(incidentReaderCsvHeaderDetection) {
+    ReadResult noHeader = readIncidents("Rohini,fire,28.7,77.1\nDwarka,2,28.6,77.0\n", 5);
+    CHECK(noHeader.rows == 2 && noHeader.rejected == 0);
+    ReadResult header = readIncidents("where,what,lat,lon\nDwarka,2,28.6,77.0\n", 5);
+    CHECK(header.rows == 1 && header.rejected == 0);
+    ReadResult empty = readIncidents("\r\n\n  \n", 1);
+    CHECK(empty.rows == 0 && empty.rejected == 0 && empty.incidents.empty());
+}
+
+TEST(incidentReaderNdjsonRowsAndErrors) {
+    const string text =
+        "{\"place\": \"Connaught Place\", \"severity\": 1, \"lat\": 28.63, \"lon\": 77.217}\r\n"
+        "{\"lon\":77.191,\"lat\":28.6517,\"severity\":\"medical\",\"place\":\"Karol \\\"Bagh\\\"\",\"extra\":[1,{\"a\":null}]}\n"
+        "\r\n"
+        "{\"place\":\"No severity\",\"lat\":28.6,\"lon\":77.2}\n"
+        "{\"place\":\"Bad severity\",\"severity\":9,\"lat\":28.6,\"lon\":77.2}\n"
+        "{\"place\":\"Bad lat\",\"severity\":1,\"lat\":\"x\",\"lon\":77.2}\n"
+        "{\"place\":\"Unclosed\",\"severity\":1,\"lat\":28.6,\"lon\":77.2\n"
+        "{\"place\":\"Trailing\",\"severity\":1,\"lat\":28.6,\"lon\":77.2} x\n"
+        "not json at all\n"
+        "{\"place\":\"Dwarka\",\"severity\":\"crime\",\"lat\":28.5971,\"lon\":77.0582}";
+    const vector<EmergencyIncident> expected = {
+        {"Connaught Place", FIRE, 28.63, 77.217},
+        {"Karol \"Bagh\"", MEDICAL_EMERGENCY, 28.6517, 77.191},
+        {"Dwarka", CRIME, 28.5971, 77.0582}};
+
+    for (size_t chunk : {text.size(), size_t(1), size_t(3), size_t(50)}) {
+        ReadResult result = readIncidents(text, chunk);
+        CHECK(sameIncidents(result.incidents, expected));
+        CHECK(result.rejected == 6);
+    }
+}
+
+// Incidents are handed on in batches, the last one at finish()
+TEST(incidentReaderBatches) {
+    string text;
+    for (int i = 0; i < 10000; ++i) text += "Place " + to_string(i) + ",1,28.5,77.1\n";
+    ReadResult result = readIncidents(text, 1 << 16);
+    CHECK(result.rows == 10000 && result.incidents.size() == 10000);
+    CHECK(result.batches == 3);
+    CHECK(result.incidents.back().place.str() == "Place 9999");
+}
+
+// ---- OsrmRouteStream ----
+
+// nlohmann's SAX parser driving the same step extractor: the reference
+Route referenceRoute(const string& body) {
+    Route route;
+    OsrmStepExtractor extractor(route);
+    ArenaJson::sax_parse(body, &extractor);
+    route.status = extractor.status();
+    if (!route.ok()) route.steps.clear();
+    return route;
+}
+
+// The push parser fed `body` in pieces of `chunk` bytes
+Route streamedRoute(const string& body, size_t chunk) {
+    Route route;
+    OsrmRouteStream stream(route);
+    for (size_t at = 0; at < body.size(); at += chunk) stream.append(body.data() + at, min(chunk, body.size() - at));
+    stream.finish();
+    return route;
+}
+
+bool sameRoute(const Route& a, const Route& b) {
+    if (a.status != b.status || a.steps.size() != b.steps.size()) return false;
+    for (size_t i = 0; i < a.steps.size(); ++i) {
+        if (a.steps[i].instruction != b.steps[i].instruction || a.steps[i].distance != b.steps[i].distance ||
+            a.steps[i].duration != b.steps[i].duration) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compares the push parser, at several chunk sizes, with nlohmann on `body`;
+// reports the first disagreement
+int routeMismatches(const string& body) {
+    Route expected = referenceRoute(body);
+    bool accepted = nlohmann::json::accept(body);
+    int mismatches = 0;
+    for (size_t chunk : {body.size() + 1, size_t(1), size_t(2), size_t(3), size_t(5), size_t(64)}) {
+        Route actual = streamedRoute(body, chunk);
+        bool agrees = sameRoute(actual, expected) && (actual.status != ROUTE_PARSE_ERROR) == accepted;
+        if (!agrees && mismatches++ == 0) {
+            cerr << "  chunk " << chunk << ": status " << actual.status << " vs " << expected.status
+                 << " on " << body.substr(0, 120) << endl;
+        }
+    }
+    return mismatches;
+}
+
+// A route body with the given step instruction and extra step fields
+string osrmBody(const string& instruction, const string& extra = "") {
+    return R"({"code":"Ok","routes":[{"geometry":"kzq~D","legs":[{"steps":[)"
+           R"({"maneuver":{"type":"depart","location":[77.2177,28.6304],"instruction":)" + instruction +
+           R"(},"distance":812.4,"duration":95.2)" + extra + R"(},)"
+           R"({"maneuver":{"type":"arrive","instruction":"You have arrived"},"distance":0,"duration":0e0}],)"
+           R"("summary":"","distance":812.4}],"weight_name":"routability"}],"waypoints":[]})";
+}
+
+TEST(osrmRouteStreamMatchesNlohmannOnValidBodies) {
+    const vector<string> bodies = {
+        osrmBody(R"("Head north on Janpath")"),
+        osrmBody(R"("Café क 🚑 \/ \"quoted\" \\ tab\t")"),
+        osrmBody("\"Chandni Chowk \xe2\x80\x93 \xe0\xa4\x9a\xe0\xa4\xbe\xe0\xa4\x81\xe0\xa4\xa6\xe0\xa4\xa8\xe0\xa5\x80 \xf0\x9f\x9a\x91\""),
+        osrmBody(R"("")", R"(,"intersections":[{"entry":[true,false,null],"bearings":[],"x":{}}],"deep":[[[[{"a":[[{}]]}]]]])"),
+        osrmBody(R"("n")", R"(,"numbers":[-0,0.5E-2,1e3,-12.5e+2,18446744073709551616,123456789012])"),
+        osrmBody(R"("n")", R"(,"numbers":[1e-400,-1e-400,4.9e-324,2.2250738585072011e-308,1.7976931348623157e308])"),
+        R"({"code":"Ok","routes":[{"legs":[{"steps":[{"maneuver":{"instruction":"tiny"},"distance":1e-400,"duration":5e-324}]}]}]})",
+        osrmBody(R"("Turn")", R"(,"distance":1.5e2,"maneuver":{"instruction":"later wins"})"),
+        "  \r\n\t" + osrmBody(R"("padded")") + " \n",
+        R"({"code":"NoRoute","routes":[]})",
+        R"({"code":"Ok","routes":[{"legs":[]}]})",
+        R"({"code":"Ok","routes":[{"legs":[{"steps":[]}]}]})",
+        R"({"routes":{"legs":"not an array"}})",
+        R"([1,2,3])",
+        "\xef\xbb\xbf" + osrmBody(R"("after a byte order mark")"),
+        R"("just a string")",
+    };
+    int mismatches = 0;
+    for (const string& body : bodies) mismatches += routeMismatches(body);
+    CHECK(mismatches == 0);
+    CHECK(streamedRoute(bodies[0], 1).ok());
+    CHECK(streamedRoute(bodies[2], 1).steps.size() == 2);
+    CHECK(streamedRoute(bodies[6], 1).ok() && streamedRoute(bodies[6], 1).steps[0].distance == 0.0);
+}
+
+TEST(osrmRouteStreamMatchesNlohmannOnBrokenBodies) {
+    const vector<string> instructions = {
+        R"("\ud83d")", R"("\ude91")", R"("\ud83dA")", R"("\ud83dx")", R"("\ud83d\n")",
+        R"("\u12G4")", R"("\u12")", R"("\x")", R"("\)",
+        "\"\xc0\xaf\"", "\"\xc1\xbf\"", "\"\xe0\x80\xaf\"", "\"\xed\xa0\x80\"", "\"\xf0\x8f\xbf\xbf\"",
+        "\"\xf4\x90\x80\x80\"", "\"\xf5\x80\x80\x80\"", "\"\x80\"", "\"\xbf\"", "\"\xe2\x82\"", "\"\xe2\x82\x22",
+        "\"\xff\"", "\"\xfe\"", "\"a\x01z\"", "\"tab\there\"", "\"new\nline\"",
+        "01", "1.", "-", "+1", ".5", "1e", "1e+", "0x10", "1e400", "-1e400", "1.8e308", "tru", "nul", "falsey", "True", "\xe2\x82\xac",
+    };
+    int mismatches = 0;
+    for (const string& instruction : instructions) mismatches += routeMismatches(osrmBody(instruction));
+
+    const vector<string> bodies = {
+        osrmBody(R"("a")", ",}"), osrmBody(R"("a")", ",,\"x\":1"), osrmBody(R"("a")", ",\"x\" 1"),
+        osrmBody(R"("a")", ",\"x\":[1,]"), osrmBody(R"("a")", ",\"x\":[1}"), osrmBody(R"("a")", ",\"x\":{1:2}"),
+        osrmBody(R"("a")") + "x", osrmBody(R"("a")") + "{}", osrmBody(R"("a")") + "]",
+        "", "   ", "{", "[", "}", R"({"routes":[)", R"({"code":"Ok",})", "nul", "\xef\xbb{}", "\xef{}", "\xef\xbb\xbf\xef\xbb\xbf{}",
+    };
+    for (const string& body : bodies) mismatches += routeMismatches(body);
+    CHECK(mismatches == 0);
+}
+
+// Every strict prefix of a body is truncated and must fail like nlohmann
+TEST(osrmRouteStreamRejectsEveryTruncation) {
+    const string body = osrmBody(R"("Café 🚑 )" "\xe0\xa4\x9a" R"(")", R"(,"n":[-1.5e-3,true,false,null])");
+    CHECK(routeMismatches(body) == 0);
+    int mismatches = 0, accepted = 0;
+    for (size_t length = 0; length < body.size(); ++length) {
+        string prefix = body.substr(0, length);
+        mismatches += routeMismatches(prefix);
+        accepted += streamedRoute(prefix, 3).status != ROUTE_PARSE_ERROR;
+    }
+    CHECK(mismatches == 0);
+    CHECK(accepted == 0);
+}
+
+// ---- IncidentServer ----
+
+// With far fewer retained results than incidents in one POST, workers evict
+// early IDs while the batch is still being registered; every ID must still
+// settle as done (200) or evicted (404), never stay queued
+TEST(incidentServerSettlesEveryPostedId) {
+    const size_t incidents = 2000, retained = 16;
+    EmergencyResponseSystem system(vector<GraphNode>{}); // no units, so nothing is routed
+    IncidentServer server(system, 8, 2, retained);
+    int port = server.start("127.0.0.1", 0);
+    CHECK(port > 0);
+    if (port <= 0) return;
+
+    nlohmann::json batch = nlohmann::json::array();
+    for (size_t i = 0; i < incidents; ++i) {
+        batch.push_back({{"place", "Sector " + to_string(i)}, {"severity", int(i % 4) + 1},
+                         {"lat", 28.6 + i * 1e-4}, {"lon", 77.2}});
+    }
+    httplib::Client http("127.0.0.1", port);
+    http.set_keep_alive(true);
+    auto posted = http.Post("/incidents", batch.dump(), "application/json");
+    CHECK(posted && posted->status == 202);
+    if (!posted) return;
+    auto reply = nlohmann::json::parse(posted->body, nullptr, false);
+    bool listed = !reply.is_discarded() && reply.contains("ids") && reply["ids"].size() == incidents;
+    CHECK(listed);
+    if (!listed) return;
+
+    size_t done = 0, evicted = 0, stuck = 0;
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(30);
+    for (const auto& id : reply["ids"]) {
+        string path = "/incidents/" + to_string(id.get<uint64_t>());
+        for (;;) {
+            auto res = http.Get(path);
+            if (res && res->status == 200) { ++done; break; }
+            if (res && res->status == 404) { ++evicted; break; }
+            if (!res || chrono::steady_clock::now() > deadline) { ++stuck; break; }
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+    CHECK(stuck == 0);
+    CHECK(done + evicted == incidents);
+    CHECK(done == retained);
+
+    auto report = http.Get("/incidents/" + to_string(reply["ids"].back().get<uint64_t>()));
+    CHECK(report && nlohmann::json::accept(report->body));
+    CHECK(http.Get("/incidents/999999999")->status == 404);
+    server.stop();
+}
+
+// ---- ResourceSpatialIndex ----
+
+// Units clustered where the grid is hardest: around both poles, on both
+// sides of the antimeridian and in one dense city, plus a sparse scatter
+vector<GraphNode> awkwardFleet(mt19937& rng, size_t units) {
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    vector<GraphNode> fleet;
+    for (size_t i = 0; i < units; ++i) {
+        double lat, lon;
+        switch (i % 5) {
+            case 0: lat = 89.0 + unit(rng); lon = -180.0 + 360.0 * unit(rng); break;
+            case 1: lat = -90.0 + unit(rng); lon = -180.0 + 360.0 * unit(rng); break;
+            case 2: lat = -5.0 + 10.0 * unit(rng); lon = unit(rng) < 0.5 ? 179.0 + unit(rng) : -180.0 + unit(rng); break;
+            case 3: lat = 28.4 + 0.4 * unit(rng); lon = 76.9 + 0.5 * unit(rng); break;
+            default: lat = -60.0 + 120.0 * unit(rng); lon = -180.0 + 360.0 * unit(rng); break;
+        }
+        fleet.emplace_back("unit " + to_string(i), lat, lon, static_cast<ResourceType>(rng() % 3));
+    }
+    return fleet;
+}
+
+// Distance to the nearest unit of `type` (any type if type < 0), or -1 if none
+double nearestByScan(const vector<GraphNode>& fleet, int type, double lat, double lon, bool availableOnly) {
+    double best = -1;
+    for (const auto& node : fleet) {
+        if ((type >= 0 && node.type != type) || (availableOnly && !node.isAvailable())) continue;
+        double distance = haversineDistance(lat, lon, node.latitude, node.longitude);
+        if (best < 0 || distance < best) best = distance;
+    }
+    return best;
+}
+
+// The index's pick may differ from the scan's on a tie, but never by distance
+TEST(spatialIndexMatchesLinearScanWhileUnitsFlip) {
+    mt19937 rng(41);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    vector<GraphNode> fleet = awkwardFleet(rng, 2000);
+    ResourceSpatialIndex index;
+    index.build(fleet);
+
+    const double toleranceKm = 1e-3;
+    vector<uint32_t> tokens(fleet.size());
+    int wrongPicks = 0, wrongLists = 0, wrongUnits = 0;
+    for (int round = 0; round < 1500; ++round) {
+        // Claim and release a few units between queries
+        for (int flips = 0; flips < 8; ++flips) {
+            size_t i = rng() % fleet.size();
+            if (fleet[i].isAvailable()) {
+                CHECK(fleet[i].tryClaim(tokens[i]));
+            } else {
+                CHECK(fleet[i].release(tokens[i]));
+            }
+            index.syncAvailability(fleet, i);
+        }
+
+        double lat, lon;
+        switch (round % 4) {
+            case 0: lat = (unit(rng) < 0.5 ? 88.0 : -90.0) + 2.0 * unit(rng); lon = -180.0 + 360.0 * unit(rng); break;
+            case 1: lat = -8.0 + 16.0 * unit(rng); lon = unit(rng) < 0.5 ? 178.5 + 1.5 * unit(rng) : -180.0 + 1.5 * unit(rng); break;
+            case 2: lat = 28.0 + unit(rng); lon = 76.5 + unit(rng); break;
+            default: lat = -80.0 + 160.0 * unit(rng); lon = -180.0 + 360.0 * unit(rng); break;
+        }
+        ResourceType type = static_cast<ResourceType>(rng() % 3);
+
+        double expected = nearestByScan(fleet, type, lat, lon, true);
+        long pick = index.nearestAvailable(fleet, type, lat, lon);
+        bool pickOk = expected < 0 ? pick == -1
+                                   : pick >= 0 && fleet[pick].type == type && fleet[pick].isAvailable() &&
+                                         haversineDistance(lat, lon, fleet[pick].latitude, fleet[pick].longitude) <=
+                                             expected + toleranceKm;
+        wrongPicks += !pickOk;
+
+        // The k-nearest list: distinct available units matching the k smallest distances
+        const size_t k = 5;
+        vector<double> scan;
+        for (const auto& node : fleet) {
+            if (node.type == type && node.isAvailable()) {
+                scan.push_back(haversineDistance(lat, lon, node.latitude, node.longitude));
+            }
+        }
+        sort(scan.begin(), scan.end());
+        scan.resize(min(scan.size(), k));
+        vector<long> list = index.nearestAvailable(fleet, type, lat, lon, k);
+        bool listOk = list.size() == scan.size() && set<long>(list.begin(), list.end()).size() == list.size();
+        for (size_t i = 0; listOk && i < list.size(); ++i) {
+            const GraphNode& node = fleet[list[i]];
+            listOk = node.type == type && node.isAvailable() &&
+                     fabs(haversineDistance(lat, lon, node.latitude, node.longitude) - scan[i]) <= toleranceKm;
+        }
+        wrongLists += !listOk;
+
+        // nearestUnit ignores type and availability
+        long nearest = index.nearestUnit(fleet, lat, lon);
+        wrongUnits += nearest < 0 || haversineDistance(lat, lon, fleet[nearest].latitude, fleet[nearest].longitude) >
+                                         nearestByScan(fleet, -1, lat, lon, false) + toleranceKm;
+    }
+    CHECK(wrongPicks == 0);
+    CHECK(wrongLists == 0);
+    CHECK(wrongUnits == 0);
+}
+
+// A unit just across the antimeridian beats a closer-looking one on the near side
+TEST(spatialIndexFindsUnitsAcrossTheAntimeridian) {
+    vector<GraphNode> fleet = {
+        {"Suva", -18.14, 178.44, AMBULANCE},
+        {"Taveuni east", -16.80, -179.95, AMBULANCE},
+        {"Apia", -13.83, -171.76, AMBULANCE},
+        {"Svalbard", 89.9, 10.0, FIRE_BRIGADE},
+        {"Over the pole", 89.9, -170.0, FIRE_BRIGADE},
+        {"Tromso", 69.65, 18.96, FIRE_BRIGADE},
+    };
+    ResourceSpatialIndex index;
+    index.build(fleet);
+    CHECK(index.nearestAvailable(fleet, AMBULANCE, -16.75, 179.98) == 1);
+    CHECK(index.nearestAvailable(fleet, FIRE_BRIGADE, 89.95, -175.0) == 4);
+
+    // Once claimed, the far-side unit is skipped until it is released
+    uint32_t token = 0;
+    CHECK(fleet[1].tryClaim(token));
+    index.syncAvailability(fleet, 1);
+    CHECK(index.nearestAvailable(fleet, AMBULANCE, -16.75, 179.98) == 0);
+    CHECK(fleet[1].release(token));
+    index.syncAvailability(fleet, 1);
+    CHECK(index.nearestAvailable(fleet, AMBULANCE, -16.75, 179.98) == 1);
+    CHECK((index.nearestAvailable(fleet, AMBULANCE, -16.75, 179.98, 3) == vector<long>{1, 0, 2}));
+}
+
+// ---- Lock-free claims ----
+
+TEST(graphNodeClaimsOnceAndRefusesStaleReleases) {
+    GraphNode unit("Ambulance_Moti", 28.5916, 77.2022, AMBULANCE);
+    uint32_t first = 0, second = 0, ignored = 0;
+    CHECK(unit.isAvailable());
+    CHECK(unit.tryClaim(first));
+    CHECK(!unit.isAvailable());
+    CHECK(!unit.tryClaim(ignored)); // double claim
+
+    CHECK(unit.release(first));
+    CHECK(!unit.release(first)); // released twice
+    CHECK(unit.tryClaim(second));
+    CHECK(second != first);
+    CHECK(!unit.release(first)); // stale token from the earlier claim
+    CHECK(!unit.isAvailable());
+    CHECK(unit.release(second));
+    CHECK(unit.isAvailable());
+}
+
+TEST(claimResourceHandsOutEachUnitOnce) {
+    vector<GraphNode> fleet;
+    for (int i = 0; i < 4; ++i) fleet.emplace_back("Ambulance " + to_string(i), 28.6 + i * 0.01, 77.2, AMBULANCE);
+    fleet.emplace_back("Fire", 28.6, 77.2, FIRE_BRIGADE);
+    EmergencyResponseSystem system(fleet);
+    EmergencyIncident incident("Karol Bagh", MEDICAL_EMERGENCY, 28.6, 77.2);
+
+    vector<GraphNode*> claimed;
+    vector<uint32_t> tokens;
+    for (int i = 0; i < 4; ++i) {
+        uint32_t token = 0;
+        GraphNode* unit = system.claimResource(incident, &token);
+        CHECK(unit && unit->type == AMBULANCE);
+        if (!unit) return;
+        claimed.push_back(unit);
+        tokens.push_back(token);
+    }
+    CHECK(set<GraphNode*>(claimed.begin(), claimed.end()).size() == 4);
+    CHECK(claimed[0]->id == "Ambulance 0"); // nearest first
+    CHECK(system.claimResource(incident) == nullptr);
+
+    // A stale token is refused and leaves the unit claimed
+    CHECK(system.releaseResource(*claimed[2], tokens[2]));
+    uint32_t token = 0;
+    CHECK(system.claimResource(incident, &token) == claimed[2]);
+    CHECK(!system.releaseResource(*claimed[2], tokens[2]));
+    CHECK(system.claimResource(incident) == nullptr);
+    CHECK(system.releaseResource(*claimed[2], token));
+}
+
+// Threads claim, hold and release units over and over; a per-unit holder
+// count catches any unit handed to two threads at once
+TEST(claimResourceRaceNeverSharesAUnit) {
+    const size_t units = 16, threads = 8, rounds = 4000;
+    vector<GraphNode> fleet;
+    for (size_t i = 0; i < units; ++i) {
+        fleet.emplace_back("Ambulance " + to_string(i), 28.5 + i * 0.02, 77.1 + (i % 4) * 0.03, AMBULANCE);
+    }
+    EmergencyResponseSystem system(fleet);
+    vector<atomic<int>> holders(units);
+    atomic<int> overlaps{0}, badReleases{0};
+    atomic<size_t> claims{0};
+    auto holderOf = [&](const GraphNode* unit) -> atomic<int>& {
+        return holders[stoul(unit->id.substr(strlen("Ambulance ")))];
+    };
+
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            mt19937 rng(t);
+            EmergencyIncident incident("race", MEDICAL_EMERGENCY, 28.6, 77.15);
+            vector<pair<GraphNode*, uint32_t>> held;
+            for (size_t r = 0; r < rounds; ++r) {
+                if (held.size() < 3 && rng() % 2) {
+                    uint32_t token = 0;
+                    GraphNode* unit = system.claimResource(incident, &token);
+                    if (!unit) continue;
+                    if (holderOf(unit).fetch_add(1) != 0) overlaps++;
+                    held.emplace_back(unit, token);
+                    claims++;
+                } else if (!held.empty()) {
+                    auto [unit, token] = held.back();
+                    held.pop_back();
+                    holderOf(unit).fetch_sub(1);
+                    if (!system.releaseResource(*unit, token)) badReleases++;
+                }
+            }
+            for (auto [unit, token] : held) {
+                holderOf(unit).fetch_sub(1);
+                if (!system.releaseResource(*unit, token)) badReleases++;
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    CHECK(overlaps == 0);
+    CHECK(badReleases == 0);
+    CHECK(claims > 0);
+    // Everything released: all units can be claimed again, each once
+    set<GraphNode*> again;
+    EmergencyIncident incident("after", MEDICAL_EMERGENCY, 28.6, 77.15);
+    while (GraphNode* unit = system.claimResource(incident)) again.insert(unit);
+    CHECK(again.size() == units);
+}
+
+// Many threads, one unit: exactly one claim wins
+TEST(graphNodeRaceHasOneWinner) {
+    for (int trial = 0; trial < 200; ++trial) {
+        GraphNode unit("contested", 0.0, 0.0, POLICE_VAN);
+        atomic<int> winners{0};
+        atomic<bool> go{false};
+        vector<thread> racers;
+        for (int t = 0; t < 8; ++t) {
+            racers.emplace_back([&] {
+                while (!go.load()) {}
+                uint32_t token = 0;
+                if (unit.tryClaim(token)) winners++;
+            });
+        }
+        go = true;
+        for (auto& racer : racers) racer.join();
+        CHECK(winners == 1);
+    }
+}
+
+// ---- LatencyRecorder ----
+
+// Every tick count lands in a bucket whose range contains it and is no wider
+// than 1/64 of its values; buckets are ordered like the ticks
+TEST(latencyBucketsRoundTrip) {
+    using Recorder = LatencyRecorder;
+    mt19937_64 rng(3);
+    vector<uint64_t> samples;
+    for (uint64_t t = 0; t < 4096; ++t) samples.push_back(t);
+    for (int i = 0; i < 20000; ++i) samples.push_back(rng() >> (64 - Recorder::MAX_TICK_BITS + rng() % 40));
+    for (int bits = 1; bits < Recorder::MAX_TICK_BITS; ++bits) {
+        samples.push_back((uint64_t(1) << bits) - 1);
+        samples.push_back(uint64_t(1) << bits);
+    }
+    int bad = 0;
+    for (uint64_t ticks : samples) {
+        size_t bucket = Recorder::bucketOf(ticks);
+        uint64_t high = Recorder::highestIn(bucket);
+        uint64_t low = bucket == 0 ? 0 : Recorder::highestIn(bucket - 1) + 1;
+        bool ok = bucket < Recorder::BUCKETS && low <= ticks && ticks <= high &&
+                  (ticks < 128 ? high == ticks : (high - low + 1) * 64 <= low);
+        bad += !ok;
+        if (ticks && Recorder::bucketOf(ticks - 1) > bucket) ++bad;
+    }
+    CHECK(bad == 0);
+    CHECK(Recorder::bucketOf((uint64_t(1) << Recorder::MAX_TICK_BITS) - 1) == Recorder::BUCKETS - 1);
+}
+
+TEST(latencyPercentilesOnKnownSamples) {
+    LatencyRecorder recorder;
+    CHECK(recorder.count(STAGE_ROUTE) == 0);
+    CHECK(recorder.percentileTicks(STAGE_ROUTE, 0.5) == 0);
+
+    // 1..100 is below 128 ticks, where every tick count has its own bucket
+    for (uint64_t t = 1; t <= 100; ++t) recorder.record(STAGE_CLAIM, t);
+    CHECK(recorder.count(STAGE_CLAIM) == 100);
+    CHECK(recorder.percentileTicks(STAGE_CLAIM, 0.5) == 50);
+    CHECK(recorder.percentileTicks(STAGE_CLAIM, 0.99) == 99);
+    CHECK(recorder.percentileTicks(STAGE_CLAIM, 0.999) == 100);
+    CHECK(recorder.percentileTicks(STAGE_CLAIM, 1.0) == 100);
+
+    // Larger values come back within 1/64, never below the sample
+    for (int i = 0; i < 900; ++i) recorder.record(STAGE_RENDER, 1000);
+    for (int i = 0; i < 99; ++i) recorder.record(STAGE_RENDER, 50000);
+    recorder.record(STAGE_RENDER, 3000000);
+    uint64_t p50 = recorder.percentileTicks(STAGE_RENDER, 0.5);
+    uint64_t p99 = recorder.percentileTicks(STAGE_RENDER, 0.99);
+    CHECK(p50 >= 1000 && p50 <= 1000 + 1000 / 64);
+    CHECK(p99 >= 50000 && p99 <= 50000 + 50000 / 64);
+    CHECK(recorder.percentileTicks(STAGE_RENDER, 0.999) == p99); // rank 999 of 1000
+    CHECK(recorder.percentileTicks(STAGE_RENDER, 1.0) == 3000000); // the top bucket is capped at the max
+    CHECK(recorder.count(STAGE_ROUTE) == 0);
+
+    // Samples from other threads are merged in
+    thread([&] { for (int i = 0; i < 100; ++i) recorder.record(STAGE_CLAIM, 7); }).join();
+    CHECK(recorder.count(STAGE_CLAIM) == 200);
+    CHECK(recorder.percentileTicks(STAGE_CLAIM, 0.5) == 7);
+    recorder.reset();
+    CHECK(recorder.count(STAGE_CLAIM) == 0 && recorder.count(STAGE_RENDER) == 0);
+}
+
+// Two recorders on one thread keep their own histograms, including one made
+// after another was destroyed
+TEST(latencyRecordersDoNotShareHistograms) {
+    auto first = make_unique<LatencyRecorder>();
+    LatencyRecorder second;
+    first->record(STAGE_WRITE, 10);
+    second.record(STAGE_WRITE, 20);
+    second.record(STAGE_WRITE, 20);
+    CHECK(first->count(STAGE_WRITE) == 1);
+    CHECK(second.count(STAGE_WRITE) == 2);
+    first.reset();
+    LatencyRecorder third;
+    third.record(STAGE_WRITE, 30);
+    CHECK(third.count(STAGE_WRITE) == 1);
+    CHECK(third.percentileTicks(STAGE_WRITE, 0.5) == 30);
+    CHECK(second.count(STAGE_WRITE) == 2);
+}
+
+// StageTimer laps into the shared recorder, and only while it is enabled
+TEST(stageTimerRecordsEachLap) {
+    LatencyRecorder& shared = sharedLatencyRecorder();
+    bool wasEnabled = shared.enabled();
+    shared.enable(false);
+    {
+        StageTimer timer;
+        timer.lap(STAGE_CLAIM);
+    }
+    shared.reset();
+    CHECK(shared.count(STAGE_CLAIM) == 0);
+
+    shared.enable();
+    {
+        StageTimer timer;
+        timer.lap(STAGE_CLAIM);
+        this_thread::sleep_for(chrono::milliseconds(2));
+        timer.lap(STAGE_ROUTE);
+        timer.lap(STAGE_RENDER);
+    }
+    CHECK(shared.count(STAGE_CLAIM) == 1);
+    CHECK(shared.count(STAGE_ROUTE) == 1);
+    CHECK(shared.count(STAGE_RENDER) == 1);
+    CHECK(shared.count(STAGE_WRITE) == 0);
+    // The 2 ms sleep lands in ROUTE; the report converts ticks back to time
+    double routeMicros = shared.percentileTicks(STAGE_ROUTE, 0.5) * shared.nanosPerTick() / 1000.0;
+    CHECK(routeMicros >= 1900.0);
+    CHECK(shared.report().find("route") != string::npos);
+    shared.reset();
+    shared.enable(wasEnabled);
+}
+
+// ---- Report rendering ----
+
+// Golden output. The three tables were checked byte for byte against the
+// original iostream printers fed the same route as OSRM JSON; 2410.65 and
+// 210.35 pin down their rounding.
+Route goldenRoute() {
+    Route route;
+    route.status = ROUTE_OK;
+    route.steps.emplace_back("Head north on Janpath", 812.4, 95.2);
+    route.steps.emplace_back("", 1320.9, 141.7);
+    route.steps.emplace_back("Turn right onto Bahadur Shah Zafar Marg towards ITO", 2410.65, 210.35);
+    return route;
+}
+
+const double goldenFactors[] = {1.0, 1.25, 1.5};
+
+const char* const goldenTrafficTable =
+    "\n=============================== ROUTE DETAILS WITH TRAFFIC ===============================\n"
+    "+--------+-----------------------------------------+---------------------+--------------+-------------------+\n"
+    "| Step   | Instruction                             | Distance (meters)   | Duration (s) | Traffic Factor    |\n"
+    "+--------+-----------------------------------------+---------------------+--------------+-------------------+\n"
+    "|      1 |                   Head north on Janpath |               812.4 |         95.2 |              1.00 |\n"
+    "|      2 |                         Follow the road |              1320.9 |        141.7 |              1.25 |\n"
+    "|      3 | Turn right onto Bahadur Shah Zafar Marg |              2410.7 |        210.3 |              1.50 |\n"
+    "+--------+-----------------------------------------+---------------------+--------------+-------------------+\n"
+    "\n============================= ESTIMATED TIME OF ARRIVAL =============================\n"
+    "| Original ETA: 7 minutes and 27 seconds                             |\n"
+    "| Traffic-Adjusted ETA: 9 minutes and 47 seconds                        |\n"
+    "===================================================================================\n\n";
+
+TEST(routeTablesMatchGoldenOutput) {
+    Route route = goldenRoute();
+    string text;
+    renderRouteTable(text, route, TABLE_DISTANCES);
+    CHECK(text ==
+          "+--------+------------------------------+-------------------+\n"
+          "| Step   | Instruction                  | Distance (meters) |\n"
+          "+--------+------------------------------+-------------------+\n"
+          "| 1      | Head north on Janpath | 812.4           |\n"
+          "| 2      | FOLLOW THE ROAD | 1320.9           |\n"
+          "| 3      | Turn right onto Bahadur Shah Zafar Marg towards ITO | 2410.65           |\n"
+          "+--------+------------------------------+-------------------+\n");
+
+    text.clear();
+    renderRouteTable(text, route, TABLE_DURATIONS);
+    CHECK(text ==
+          "\n================================= ROUTE DETAILS =================================\n"
+          "+--------+-----------------------------------------+---------------------+--------------+\n"
+          "| Step   | Instruction                             | Distance (meters)   | Duration (s) |\n"
+          "+--------+-----------------------------------------+---------------------+--------------+\n"
+          "|      1 |                   Head north on Janpath |               812.4 |         95.2 |\n"
+          "|      2 |                         Follow the road |              1320.9 |        141.7 |\n"
+          "|      3 | Turn right onto Bahadur Shah Zafar Marg |              2410.7 |        210.3 |\n"
+          "+--------+-----------------------------------------+---------------------+--------------+\n"
+          "\n==================================== ETA ======================================\n"
+          "| Estimated Time of Arrival (ETA): 7 minutes and 27 seconds |\n"
+          "==============================================================================\n\n");
+
+    text.clear();
+    renderRouteTable(text, route, TABLE_TRAFFIC, goldenFactors);
+    CHECK(text == goldenTrafficTable);
+
+    // Arena-backed text renders the same bytes
+    pmr::monotonic_buffer_resource arena;
+    pmr::string pmrText(&arena);
+    renderRouteTable(pmrText, route, TABLE_TRAFFIC, goldenFactors);
+    CHECK(string_view(pmrText) == goldenTrafficTable);
+
+    // Unusable routes say why, in every layout
+    Route broken;
+    broken.error = "syntax error at byte 7: invalid literal";
+    Route empty;
+    empty.status = ROUTE_NO_ROUTES;
+    for (RouteTableLayout layout : {TABLE_DISTANCES, TABLE_DURATIONS, TABLE_TRAFFIC}) {
+        text.clear();
+        renderRouteTable(text, broken, layout, goldenFactors);
+        CHECK(text == "Error parsing route JSON: syntax error at byte 7: invalid literal\n");
+        text.clear();
+        renderRouteTable(text, empty, layout, goldenFactors);
+        CHECK(text == "No routes available in the response.\n");
+    }
+}
+
+TEST(dispatchReportsMatchGoldenOutput) {
+    Route route = goldenRoute();
+    Route broken;
+    broken.error = "syntax error at byte 7: invalid \"literal\"";
+    GraphNode unit("Fire_Connaught", 28.6304, 77.2177, FIRE_BRIGADE);
+    EmergencyIncident incident("Karol \"Bagh\"", FIRE, 28.65, 77.19);
+    auto render = [&](ReportFormat format, const GraphNode* resource, const Route* shown, const double* factors) {
+        string text;
+        renderDispatch(text, format, incident, resource, shown, factors);
+        return text;
+    };
+
+    CHECK(render(REPORT_TABLE, &unit, &route, goldenFactors) ==
+          string("Dispatching resource Fire_Connaught to incident at Karol \"Bagh\"\n") + goldenTrafficTable);
+    CHECK(render(REPORT_COMPACT, &unit, &route, goldenFactors) ==
+          "Dispatching resource Fire_Connaught to incident at Karol \"Bagh\": 3 steps, 4.5 km, "
+          "ETA 7 min 27 s, with traffic 9 min 47 s\n");
+    string json = render(REPORT_JSON, &unit, &route, goldenFactors);
+    CHECK(json ==
+          R"({"incident":"Karol \"Bagh\"","resource":"Fire_Connaught","route":{"status":"ok","steps":[)"
+          R"({"instruction":"Head north on Janpath","distance_m":812.4,"duration_s":95.2,"traffic_factor":1.00},)"
+          R"({"instruction":"","distance_m":1320.9,"duration_s":141.7,"traffic_factor":1.25},)"
+          R"({"instruction":"Turn right onto Bahadur Shah Zafar Marg towards ITO","distance_m":2410.7,"duration_s":210.3,"traffic_factor":1.50}],)"
+          R"("distance_m":4544.0,"duration_s":447.2,"traffic_duration_s":587.8}})" "\n");
+
+    // A parse error is reported, not dropped
+    CHECK(render(REPORT_TABLE, &unit, &broken, nullptr) ==
+          "Dispatching resource Fire_Connaught to incident at Karol \"Bagh\"\n"
+          "Error parsing route JSON: syntax error at byte 7: invalid \"literal\"\n");
+    CHECK(render(REPORT_COMPACT, &unit, &broken, nullptr) ==
+          "Dispatching resource Fire_Connaught to incident at Karol \"Bagh\": no route (Error parsing route JSON)\n");
+    string brokenJson = render(REPORT_JSON, &unit, &broken, nullptr);
+    CHECK(brokenJson ==
+          R"({"incident":"Karol \"Bagh\"","resource":"Fire_Connaught","route":{"status":"error","error":"syntax error at byte 7: invalid \"literal\""}})" "\n");
+
+    // No unit free
+    CHECK(render(REPORT_TABLE, nullptr, nullptr, nullptr) == "No available resources for incident at Karol \"Bagh\"\n");
+    CHECK(render(REPORT_COMPACT, nullptr, nullptr, nullptr) == "No available resources for incident at Karol \"Bagh\"\n");
+    string noUnitJson = render(REPORT_JSON, nullptr, nullptr, nullptr);
+    CHECK(noUnitJson == "{\"incident\":\"Karol \\\"Bagh\\\"\",\"resource\":null}\n");
+
+    // Every JSON report is one valid JSON document, control characters included
+    Route odd = goldenRoute();
+    odd.steps[0].instruction = "tab\there \\ newline\n bell\x07";
+    string oddJson = render(REPORT_JSON, &unit, &odd, goldenFactors);
+    for (const string* text : {&json, &brokenJson, &noUnitJson, &oddJson}) {
+        CHECK(nlohmann::json::accept(*text));
+    }
+    auto parsed = nlohmann::json::parse(oddJson);
+    CHECK(parsed["route"]["steps"][0]["instruction"] == "tab\there \\ newline\n bell\x07");
+    CHECK(parsed["incident"] == "Karol \"Bagh\"");
+}
+
+// ---- Batch haversine ----
+
+// Every batch kernel this build and CPU can run, by name
+vector<pair<const char*, BatchDistanceKernel>> batchDistanceKernels() {
+    vector<pair<const char*, BatchDistanceKernel>> kernels = {{"scalar", batchHaversineScalar}};
+#ifdef ERS_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) kernels.emplace_back("avx2", batchHaversineAvx2);
+#endif
+    kernels.emplace_back("dispatched", batchHaversineKm);
+    return kernels;
+}
+
+// Worst error of each kernel against haversineDistance for one query over
+// `lat`/`lon`, split into pairs more than 1200 km from antipodal and the rest
+struct KernelError {
+    double normal = 0.0, nearAntipodal = 0.0;
+};
+
+void measureKernels(double qLat, double qLon, const vector<double>& lat, const vector<double>& lon,
+                    map<string, KernelError>& errors) {
+    const double halfCircumferenceKm = M_PI * 6371;
+    size_t n = lat.size();
+    vector<double> latRad(n), lonRad(n), cosLat(n), out(n);
+    for (size_t i = 0; i < n; ++i) {
+        DistanceQuery trig(lat[i], lon[i]);
+        latRad[i] = trig.latRad;
+        lonRad[i] = trig.lonRad;
+        cosLat[i] = trig.cosLat;
+    }
+    DistanceQuery query(qLat, qLon);
+    for (auto [name, kernel] : batchDistanceKernels()) {
+        kernel(query, latRad.data(), lonRad.data(), cosLat.data(), n, out.data());
+        KernelError& error = errors[name];
+        for (size_t i = 0; i < n; ++i) {
+            double reference = haversineDistance(qLat, qLon, lat[i], lon[i]);
+            double& worst = reference < halfCircumferenceKm - 1200 ? error.normal : error.nearAntipodal;
+            worst = max(worst, fabs(out[i] - reference));
+        }
+    }
+}
+
+// The documented bounds: within 1e-6 km (1 mm) of haversineDistance for
+// pairs more than 1200 km from antipodal, and within 50 m even at the
+// antipode. Both the AVX2 and scalar paths are held to them, with odd batch
+// sizes so the AVX2 tail goes through the scalar code.
+TEST(batchHaversineStaysWithinItsErrorBound) {
+    const double boundKm = 1e-6;
+    mt19937 rng(5);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    auto randomLat = [&] { return asin(2 * unit(rng) - 1) * 180.0 / M_PI; }; // uniform over the sphere
+    auto randomLon = [&] { return -180.0 + 360.0 * unit(rng); };
+
+    map<string, KernelError> errors;
+    for (int q = 0; q < 200; ++q) {
+        double qLat = q % 10 == 0 ? (q % 20 ? 90.0 : -90.0) : randomLat(), qLon = randomLon();
+        vector<double> lat, lon;
+        for (size_t i = 0; i < 257; ++i) {
+            switch (i % 4) {
+                case 0: lat.push_back(randomLat()); lon.push_back(randomLon()); break;
+                case 1: // antipodal neighbourhood
+                    lat.push_back(max(-90.0, min(90.0, -qLat + 20.0 * (unit(rng) - 0.5))));
+                    lon.push_back(fmod(qLon + 360.0 + 20.0 * (unit(rng) - 0.5), 360.0) - 180.0);
+                    break;
+                case 2: // across the antimeridian and near the query
+                    lat.push_back(max(-90.0, min(90.0, qLat + unit(rng) - 0.5)));
+                    lon.push_back(unit(rng) < 0.5 ? 180.0 - unit(rng) : -180.0 + unit(rng));
+                    break;
+                default: // within a few link radii of the query
+                    lat.push_back(max(-90.0, min(90.0, qLat + 0.5 * (unit(rng) - 0.5))));
+                    lon.push_back(qLon + 0.5 * (unit(rng) - 0.5));
+                    break;
+            }
+        }
+        measureKernels(qLat, qLon, lat, lon, errors);
+    }
+    CHECK(errors.count("scalar") && errors.count("dispatched"));
+    for (const auto& [name, error] : errors) {
+        if (error.normal > boundKm) cerr << "  " << name << ": " << error.normal << " km off" << endl;
+        CHECK(error.normal <= boundKm);
+        CHECK(error.nearAntipodal <= 0.05);
+    }
+}
+
+// The station graph links pairs at most 20 km apart, so the batch distance
+// must put every pair on the same side of 20 km as haversineDistance unless
+// it is within the error bound of the threshold
+TEST(batchHaversineAgreesOnTheLinkRadius) {
+    const double radiusKm = 20.0, boundKm = 1e-6;
+    mt19937 rng(8);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    int disagreements = 0;
+    for (int q = 0; q < 100; ++q) {
+        double qLat = -89.0 + 178.0 * unit(rng), qLon = -180.0 + 360.0 * unit(rng);
+        DistanceQuery query(qLat, qLon);
+        vector<double> latRad, lonRad, cosLat, reference;
+        for (int i = 0; i < 101; ++i) {
+            // Points 20 km +- 10 m away on a random bearing
+            double bearing = 2 * M_PI * unit(rng);
+            double angle = (radiusKm + 0.02 * (unit(rng) - 0.5)) / 6371;
+            double lat1 = qLat * M_PI / 180.0, lon1 = qLon * M_PI / 180.0;
+            double lat2 = asin(sin(lat1) * cos(angle) + cos(lat1) * sin(angle) * cos(bearing));
+            double lon2 = lon1 + atan2(sin(bearing) * sin(angle) * cos(lat1), cos(angle) - sin(lat1) * sin(lat2));
+            double lon2Deg = fmod(lon2 * 180.0 / M_PI + 540.0, 360.0) - 180.0;
+            DistanceQuery trig(lat2 * 180.0 / M_PI, lon2Deg);
+            latRad.push_back(trig.latRad);
+            lonRad.push_back(trig.lonRad);
+            cosLat.push_back(trig.cosLat);
+            reference.push_back(haversineDistance(qLat, qLon, lat2 * 180.0 / M_PI, lon2Deg));
+        }
+        vector<double> out(reference.size());
+        for (auto [name, kernel] : batchDistanceKernels()) {
+            kernel(query, latRad.data(), lonRad.data(), cosLat.data(), out.size(), out.data());
+            for (size_t i = 0; i < out.size(); ++i) {
+                if (fabs(reference[i] - radiusKm) <= boundKm) continue;
+                disagreements += (out[i] <= radiusKm) != (reference[i] <= radiusKm);
+            }
+        }
+    }
+    CHECK(disagreements == 0);
+}
+
+// ---- RouteCache ----
+
+RoutePtr namedRoute(const string& instruction) {
+    auto route = make_shared<Route>();
+    route->status = ROUTE_OK;
+    route->steps.emplace_back(instruction, 1.0, 1.0);
+    return route;
+}
+
+// The route cached for a trip, or "" on a miss
+string cachedName(RouteCache& cache, double startLat, double startLon, double endLat, double endLon) {
+    RoutePtr route;
+    if (!cache.lookup(startLat, startLon, endLat, endLon, route)) return "";
+    return string(route->steps[0].instruction);
+}
+
+TEST(routeCacheEvictsLeastRecentlyUsed) {
+    RouteCache cache(3);
+    cache.store(28.60, 77.20, 28.61, 77.21, namedRoute("a"));
+    cache.store(28.62, 77.20, 28.61, 77.21, namedRoute("b"));
+    cache.store(28.63, 77.20, 28.61, 77.21, namedRoute("c"));
+    CHECK(cachedName(cache, 28.60, 77.20, 28.61, 77.21) == "a"); // a is now the most recent
+
+    cache.store(28.64, 77.20, 28.61, 77.21, namedRoute("d")); // evicts b
+    CHECK(cache.size() == 3);
+    CHECK(cachedName(cache, 28.62, 77.20, 28.61, 77.21) == "");
+    CHECK(cachedName(cache, 28.60, 77.20, 28.61, 77.21) == "a");
+    CHECK(cachedName(cache, 28.63, 77.20, 28.61, 77.21) == "c");
+    CHECK(cachedName(cache, 28.64, 77.20, 28.61, 77.21) == "d");
+
+    // Storing an existing trip replaces it and makes it the most recent
+    cache.store(28.60, 77.20, 28.61, 77.21, namedRoute("a2"));
+    CHECK(cache.size() == 3);
+    cache.store(28.65, 77.20, 28.61, 77.21, namedRoute("e")); // evicts c, the least recent now
+    CHECK(cachedName(cache, 28.63, 77.20, 28.61, 77.21) == "");
+    CHECK(cachedName(cache, 28.60, 77.20, 28.61, 77.21) == "a2");
+    CHECK(cachedName(cache, 28.64, 77.20, 28.61, 77.21) == "d");
+    CHECK(cachedName(cache, 28.65, 77.20, 28.61, 77.21) == "e");
+    CHECK(cache.hits() == 7);
+    CHECK(cache.misses() == 2);
+
+    cache.clear();
+    CHECK(cache.size() == 0);
+    CHECK(cachedName(cache, 28.65, 77.20, 28.61, 77.21) == "");
+}
+
+TEST(routeCacheExpiresEntries) {
+    RouteCache cache(16, chrono::milliseconds(100));
+    cache.store(28.60, 77.20, 28.61, 77.21, namedRoute("old"));
+    CHECK(cachedName(cache, 28.60, 77.20, 28.61, 77.21) == "old");
+    this_thread::sleep_for(chrono::milliseconds(60));
+    cache.store(28.70, 77.20, 28.61, 77.21, namedRoute("young"));
+    this_thread::sleep_for(chrono::milliseconds(60));
+    // A hit does not extend an entry's life
+    CHECK(cachedName(cache, 28.60, 77.20, 28.61, 77.21) == "");
+    CHECK(cache.size() == 1); // the expired entry is dropped on lookup
+    CHECK(cachedName(cache, 28.70, 77.20, 28.61, 77.21) == "young");
+    // Storing again restarts the clock
+    cache.store(28.60, 77.20, 28.61, 77.21, namedRoute("renewed"));
+    CHECK(cachedName(cache, 28.60, 77.20, 28.61, 77.21) == "renewed");
+}
+
+// Trips snap to cells of `quantum` degrees: the same cell shares an entry,
+// a neighbouring cell in any of the four coordinates does not
+TEST(routeCacheKeysSnapToTheQuantumGrid) {
+    const double quantum = 1e-4;
+    RouteCache cache(64, chrono::minutes(10), quantum);
+    const double trip[4] = {28.6304, 77.2177, -33.8688, -151.2093};
+    cache.store(trip[0], trip[1], trip[2], trip[3], namedRoute("trip"));
+
+    // Within half a cell of the stored point, in every coordinate
+    CHECK(cachedName(cache, trip[0] + 0.4 * quantum, trip[1] - 0.4 * quantum,
+                     trip[2] + 0.4 * quantum, trip[3] - 0.4 * quantum) == "trip");
+    for (int c = 0; c < 4; ++c) {
+        for (double step : {-quantum, quantum}) {
+            double moved[4] = {trip[0], trip[1], trip[2], trip[3]};
+            moved[c] += step;
+            CHECK(cachedName(cache, moved[0], moved[1], moved[2], moved[3]) == "");
+        }
+    }
+    // Start and end are not interchangeable
+    CHECK(cachedName(cache, trip[2], trip[3], trip[0], trip[1]) == "");
+
+    // Cells are centred on multiples of the quantum, either side of zero
+    cache.store(0.00004, -0.00004, 0.0, 0.0, namedRoute("origin"));
+    CHECK(cachedName(cache, -0.00004, 0.00004, 0.0, 0.0) == "origin");
+    CHECK(cachedName(cache, 0.00006, 0.0, 0.0, 0.0) == "");
+    CHECK(cachedName(cache, -0.00006, 0.0, 0.0, 0.0) == "");
+}
+
+// With a fine quantum, coordinates far apart must not share a key: cells
+// that wrapped at 32 bits would put lon 179.9 on top of lon 8.10130816
+TEST(routeCacheFineQuantumNeverAliases) {
+    RouteCache cache(64, chrono::minutes(10), 1e-8);
+    cache.store(10.0, 179.9, 10.0, 179.9, namedRoute("far east"));
+    CHECK(cachedName(cache, 10.0, 8.10130816, 10.0, 8.10130816) == "");
+    CHECK(cachedName(cache, 10.0, 179.9, 10.0, 179.9) == "far east");
+    CHECK(cachedName(cache, 10.0, 179.9 + 2e-8, 10.0, 179.9) == "");
+
+    // A quantum that makes no sense falls back to the default (1e-4)
+    RouteCache broken(8, chrono::minutes(10), 0.0);
+    broken.store(28.6304, 77.2177, 28.61, 77.21, namedRoute("default grid"));
+    CHECK(cachedName(broken, 28.63043, 77.2177, 28.61, 77.21) == "default grid");
+    CHECK(cachedName(broken, 28.6306, 77.2177, 28.61, 77.21) == "");
+}
+
+// ---- Batched dispatch ----
+
+// Everything `run` writes to stdout
+template <typename Run>
+string captureStdout(Run run) {
+    char path[] = "/tmp/ers_stdout_XXXXXX";
+    int file = mkstemp(path);
+    if (file < 0) return "";
+    cout.flush();
+    int saved = dup(1);
+    dup2(file, 1);
+    run();
+    cout.flush();
+    dup2(saved, 1);
+    close(saved);
+    close(file);
+    string text = readFile(path);
+    remove(path);
+    return text;
+}
+
+// Batched dispatch fetches the misses concurrently into one arena and
+// reports in priority order; a second system sharing the cache is served
+// entirely from the heap copies the first left behind
+TEST(batchedDispatchRoutesEveryAssignment) {
+    httplib::Server osrm;
+    atomic<int> requests{0};
+    osrm.Get(R"(/route/v1/driving/.*)", [&](const httplib::Request&, httplib::Response& res) {
+        ++requests;
+        res.set_content(osrmBody(R"("Head north on Janpath")"), "application/json");
+    });
+    int port = osrm.bind_to_any_port("127.0.0.1");
+    thread listener([&] { osrm.listen_after_bind(); });
+    osrm.wait_until_ready();
+    OsrmClient client("http://127.0.0.1:" + to_string(port));
+    RouteCache cache;
+
+    const size_t incidents = 40;
+    vector<GraphNode> fleet;
+    for (size_t i = 0; i < incidents + 10; ++i) {
+        fleet.emplace_back("Ambulance_" + to_string(i), 28.5 + i * 0.004, 77.1, AMBULANCE);
+    }
+    auto dispatchBurst = [&] {
+        EmergencyResponseSystem system(fleet);
+        system.setRoutingClient(client);
+        system.setRouteCache(&cache);
+        system.setReportFormat(REPORT_JSON);
+        for (size_t i = 0; i < incidents; ++i) {
+            system.addIncident({"Sector " + to_string(i), MEDICAL_EMERGENCY, 28.5 + i * 0.004, 77.11});
+        }
+        return captureStdout([&] { system.dispatchResourcesBatched(); });
+    };
+
+    for (int pass = 0; pass < 2; ++pass) {
+        istringstream lines(dispatchBurst());
+        string line;
+        size_t reports = 0, routed = 0;
+        while (getline(lines, line)) {
+            ++reports;
+            auto report = nlohmann::json::parse(line, nullptr, false);
+            routed += !report.is_discarded() && report["resource"].is_string() &&
+                      report["route"]["status"] == "ok" && report["route"]["steps"].size() == 2 &&
+                      report["route"]["steps"][0]["instruction"] == "Head north on Janpath";
+        }
+        CHECK(reports == incidents);
+        CHECK(routed == incidents);
+        CHECK(requests == static_cast<int>(incidents)); // the second pass is all cache hits
+    }
+    osrm.stop();
+    listener.join();
+}
+
+// ---- Mutual aid ----
+
+// Metres from `start` to every station along the links, with the search's
+// own rounding of each link, by binary-heap Dijkstra; UINT32_MAX if unreached
+vector<uint32_t> stationDistances(const StationGraph& graph, uint32_t start, uint32_t startMetres) {
+    vector<uint32_t> distance(graph.stationCount(), UINT32_MAX);
+    priority_queue<pair<uint64_t, uint32_t>, vector<pair<uint64_t, uint32_t>>, greater<>> queue;
+    distance[start] = startMetres;
+    queue.push({startMetres, start});
+    while (!queue.empty()) {
+        auto [metres, station] = queue.top();
+        queue.pop();
+        if (metres != distance[station]) continue;
+        for (size_t l = graph.firstLink(station); l < graph.endLink(station); ++l) {
+            uint64_t next = metres + static_cast<uint64_t>(lround(graph.weight(l) * 1000.0f));
+            if (next < distance[graph.target(l)]) {
+                distance[graph.target(l)] = static_cast<uint32_t>(next);
+                queue.push({next, graph.target(l)});
+            }
+        }
+    }
+    return distance;
+}
+
+// Random sparse graph with links up to 20 km, some stations isolated
+void randomStationGraph(mt19937& rng, size_t stations, StationGraph& graph) {
+    set<pair<uint32_t, uint32_t>> pairs;
+    for (size_t i = 0; i < stations * 2; ++i) {
+        uint32_t a = rng() % stations, b = rng() % stations;
+        if (a != b && a % 17 != 0 && b % 17 != 0) pairs.insert({min(a, b), max(a, b)});
+    }
+    vector<StationGraph::Link> links;
+    uniform_real_distribution<double> km(0.0, 20.0);
+    for (auto [from, to] : pairs) links.push_back({from, to, km(rng)});
+    graph.build(stations, links);
+}
+
+// With accept() always false the search visits every station within the
+// radius once, in order of distance; with a random accept() it returns the
+// nearest accepted station. One search object serves graphs of several
+// sizes, so stale workspace from earlier searches would show.
+TEST(mutualAidSearchMatchesDijkstra) {
+    mt19937 rng(17);
+    MutualAidSearch search;
+    int wrongVisits = 0, wrongOrder = 0, wrongPicks = 0;
+    for (int trial = 0; trial < 300; ++trial) {
+        StationGraph graph;
+        randomStationGraph(rng, 10 + rng() % 400, graph);
+        uint32_t start = rng() % graph.stationCount();
+        uint32_t startMetres = rng() % 3000;
+        uint32_t radius = trial % 10 == 0 ? UINT32_MAX / 2 : startMetres + rng() % 60000;
+        vector<uint32_t> expected = stationDistances(graph, start, startMetres);
+
+        vector<uint32_t> visited;
+        long none = search.run(graph, start, startMetres, radius, [&](uint32_t station) {
+            visited.push_back(station);
+            return false;
+        });
+        set<uint32_t> reachable;
+        for (uint32_t s = 0; s < expected.size(); ++s) {
+            if (expected[s] <= radius) reachable.insert(s);
+        }
+        wrongVisits += none != -1 || visited.size() != reachable.size() ||
+                       set<uint32_t>(visited.begin(), visited.end()) != reachable;
+        for (size_t i = 1; i < visited.size(); ++i) wrongOrder += expected[visited[i - 1]] > expected[visited[i]];
+
+        // Accept a random third of the stations
+        vector<bool> acceptable(graph.stationCount());
+        uint32_t best = UINT32_MAX;
+        for (uint32_t s = 0; s < acceptable.size(); ++s) {
+            acceptable[s] = rng() % 3 == 0;
+            if (acceptable[s] && expected[s] <= radius) best = min(best, expected[s]);
+        }
+        long pick = search.run(graph, start, startMetres, radius, [&](uint32_t station) { return acceptable[station]; });
+        wrongPicks += best == UINT32_MAX ? pick != -1 : (pick < 0 || !acceptable[pick] || expected[pick] != best);
+    }
+    CHECK(wrongVisits == 0);
+    CHECK(wrongOrder == 0);
+    CHECK(wrongPicks == 0);
+
+    // A start already beyond the radius, or outside the graph, finds nothing
+    StationGraph graph;
+    graph.build(2, {{0, 1, 1.0}});
+    CHECK(search.run(graph, 0, 5000, 4000, [](uint32_t) { return true; }) == -1);
+    CHECK(search.run(graph, 7, 0, 4000, [](uint32_t) { return true; }) == -1);
+    CHECK(search.run(graph, 0, 0, 999, [](uint32_t station) { return station == 1; }) == -1);
+    CHECK(search.run(graph, 0, 0, 1000, [](uint32_t station) { return station == 1; }) == 1);
+}
+
+// The mutual-aid claim walks the station graph, and falls back to the
+// nearest free unit when nothing suitable is within the radius
+TEST(mutualAidClaimsAlongLinksAndFallsBack) {
+    vector<GraphNode> fleet = {
+        {"Police_Central", 28.6000, 77.2000, POLICE_VAN},     // nearest station to the incident
+        {"Police_North", 28.6900, 77.2000, POLICE_VAN},       // 10 km north
+        {"Ambulance_North", 28.6950, 77.2000, AMBULANCE},     // beside Police_North
+        {"Ambulance_Far", 29.5000, 77.2000, AMBULANCE},       // 100 km away, no links
+        {"Fire_South", 28.5500, 77.2000, FIRE_BRIGADE},       // 5.6 km south
+    };
+    EmergencyResponseSystem system(fleet);
+    EmergencyIncident medical("Connaught Place", MEDICAL_EMERGENCY, 28.6010, 77.2000);
+
+    // Ambulance_North is 10.7 km along the links
+    system.setMutualAidRadius(15.0);
+    uint32_t token = 0;
+    GraphNode* unit = system.claimResource(medical, &token);
+    CHECK(unit && unit->id == "Ambulance_North");
+    if (unit) CHECK(system.releaseResource(*unit, token));
+
+    // Out of reach at 5 km: the nearest free ambulance anywhere
+    system.setMutualAidRadius(5.0);
+    unit = system.claimResource(medical, &token);
+    CHECK(unit && unit->id == "Ambulance_North");
+    // With that one busy, the fallback finds the unlinked one 100 km away
+    GraphNode* second = system.claimResource(medical);
+    CHECK(second && second->id == "Ambulance_Far");
+    CHECK(system.claimResource(medical) == nullptr);
+    if (unit) CHECK(system.releaseResource(*unit, token));
+
+    // Claims made along the links are honoured by the index and the plain path
+    system.setMutualAidRadius(15.0);
+    GraphNode* viaLinks = system.claimResource(medical);
+    CHECK(viaLinks && viaLinks->id == "Ambulance_North");
+    system.setMutualAidRadius(0.0);
+    CHECK(system.claimResource(medical) == nullptr);
+
+    EmergencyIncident fire("Lodhi Road", FIRE, 28.6010, 77.2000);
+    system.setMutualAidRadius(1.0);
+    GraphNode* engine = system.claimResource(fire);
+    CHECK(engine && engine->id == "Fire_South");
+}
+
+// ---- Station graph ----
+
+// Fleets clustered where the link grid is awkward: across the antimeridian,
+// around a pole, or (with polar = false) spread over mid latitudes only so
+// that the grid has many narrow columns
+vector<GraphNode> clusteredFleet(mt19937& rng, size_t units, bool polar) {
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    vector<GraphNode> fleet;
+    for (size_t i = 0; i < units; ++i) {
+        double lat, lon;
+        switch (rng() % (polar ? 3 : 2)) {
+            case 0:  // within 0.3 degrees of +-180
+                lat = -60.0 + 120.0 * unit(rng);
+                lon = unit(rng) < 0.5 ? 179.7 + 0.3 * unit(rng) : -180.0 + 0.3 * unit(rng);
+                if (rng() % 20 == 0) lon = rng() % 2 ? 180.0 : -180.0;
+                break;
+            case 1:  // a mid-latitude cluster
+                lat = 40.0 + 0.6 * unit(rng);
+                lon = -3.0 + 0.6 * unit(rng);
+                break;
+            default:  // the last 0.3 degrees before either pole
+                lat = (rng() % 2 ? 1.0 : -1.0) * (89.7 + 0.3 * unit(rng));
+                lon = -180.0 + 360.0 * unit(rng);
+                break;
+        }
+        // Narrow the antimeridian band in latitude so it is dense enough to link
+        if (fabs(lon) > 179.0) lat = lat * 0.01 + (polar ? 0.0 : 55.0);
+        fleet.emplace_back("Unit_" + to_string(i), lat, lon, static_cast<ResourceType>(rng() % 3));
+    }
+    return fleet;
+}
+
+// The bucketed build links exactly the pairs an O(n^2) comparison does,
+// for every thread count. Pairs within a hair of the radius are skipped,
+// as the batch kernel and haversineDistance may round them differently.
+TEST(stationGraphMatchesPairwiseLinks) {
+    mt19937 rng(23);
+    int missing = 0, extra = 0, compared = 0;
+    for (int trial = 0; trial < 12; ++trial) {
+        vector<GraphNode> fleet = clusteredFleet(rng, 300 + rng() % 300, trial % 2 == 0);
+        set<pair<uint32_t, uint32_t>> expected, ambiguous;
+        for (uint32_t i = 0; i < fleet.size(); ++i) {
+            for (uint32_t j = i + 1; j < fleet.size(); ++j) {
+                double km = haversineDistance(fleet[i].latitude, fleet[i].longitude,
+                                              fleet[j].latitude, fleet[j].longitude);
+                if (fabs(km - 20.0) < 1e-5) ambiguous.insert({i, j});
+                else if (km <= 20.0) expected.insert({i, j});
+            }
+        }
+        EmergencyResponseSystem system(fleet, 1 + trial % 4);
+        const StationGraph& graph = system.stations();
+        set<pair<uint32_t, uint32_t>> built;
+        for (uint32_t s = 0; s < graph.stationCount(); ++s) {
+            for (size_t l = graph.firstLink(s); l < graph.endLink(s); ++l) {
+                uint32_t t = graph.target(l);
+                if (s < t && !ambiguous.count({s, t})) built.insert({s, t});
+            }
+        }
+        for (const auto& link : expected) missing += !built.count(link);
+        for (const auto& link : built) extra += !expected.count(link);
+        compared += static_cast<int>(expected.size());
+    }
+    CHECK(missing == 0);
+    CHECK(extra == 0);
+    CHECK(compared > 1000);
+}
+
+int main(int argc, char* argv[]) {
+    string filter = argc > 1 ? argv[1] : "";
+    int run = 0, failed = 0;
+    for (const TestCase& test : testCases()) {
+        if (!filter.empty() && string(test.name).find(filter) == string::npos) continue;
+        int before = failedChecks;
+        test.run();
+        bool passed = failedChecks == before;
+        cout << (passed ? "PASS " : "FAIL ") << test.name << endl;
+        ++run;
+        failed += !passed;
+    }
+    cout << run - failed << "/" << run << " tests passed" << endl;
+    return failed ? 1 : 0;
+}